@@ -31,8 +31,10 @@
 #include "SMESH_MeshAlgos.hxx"
 
 #include <gp_Ax2.hxx>
+#include <OSD_Parallel.hxx>
 
 //#include "utilities.h"
+#include <algorithm>
 #include <limits>
 
 // Define error message
@@ -85,27 +87,142 @@ namespace
 
   //================================================================================
   /*!
-   * \brief return true if a node is at block corner
+   * \brief Node to face adjacency of the skin in compressed (CSR) form, with
+   *        block corner flags of nodes computed once for the whole skin
    *
-   * This check is valid for simple cases only
+   * A node is at block corner if it is shared by an odd number of faces or if
+   * its faces have an unexpected number of distinct nodes. This check is
+   * valid for simple cases only
    */
   //================================================================================
 
-  bool isCornerNode( const SMDS_MeshNode* n )
+  class _SkinAdjacency
   {
-    int nbF = n ? n->NbInverseElements( SMDSAbs_Face ) : 1;
-    if ( nbF % 2 )
-      return true;
+  public:
+    void build( const SMDS_Mesh* mesh );
+    //!< return true if a node is at block corner
+    bool isCorner( const SMDS_MeshNode* n ) const
+    {
+      if ( !n ) return true;
+      smIdType id = n->GetID();
+      return ( id < 0 || id >= (smIdType) _isCorner.size() || _isCorner[ id ] );
+    }
+    const SMDS_MeshElement* findFace( const SMDS_MeshNode*    n1,
+                                      const SMDS_MeshNode*    n2,
+                                      const SMDS_MeshElement* avoidFace,
+                                      int*                    i1,
+                                      int*                    i2 ) const;
+  private:
+    std::vector< smIdType >                _faceStart; //!< by node ID, to _nodeFaces
+    std::vector< const SMDS_MeshElement* > _nodeFaces;
+    std::vector< char >                    _isCorner;  //!< by node ID
+  };
+
+  //================================================================================
+  /*!
+   * \brief Fill adjacency by one pass over faces and classify all nodes
+   */
+  //================================================================================
 
-    std::set<const SMDS_MeshNode*> nodesInInverseFaces;
-    SMDS_ElemIteratorPtr fIt = n->GetInverseElementIterator(SMDSAbs_Face );
+  void _SkinAdjacency::build( const SMDS_Mesh* mesh )
+  {
+    const smIdType nbIDs = mesh->MaxNodeID() + 1;
+    _faceStart.assign( nbIDs + 1, 0 );
+    _nodeFaces.clear();
+    _isCorner.clear();
+
+    // count faces of nodes
+    std::vector< const SMDS_MeshElement* > faces;
+    faces.reserve( mesh->NbFaces() );
+    SMDS_ElemIteratorPtr fIt = mesh->elementsIterator( SMDSAbs_Face );
     while ( fIt->more() )
     {
       const SMDS_MeshElement* face = fIt->next();
-      nodesInInverseFaces.insert( face->begin_nodes(), face->end_nodes() );
+      faces.push_back( face );
+      for ( int i = 0; i < face->NbNodes(); ++i )
+        ++_faceStart[ face->GetNode( i )->GetID() + 1 ];
     }
+    for ( smIdType id = 0; id < nbIDs; ++id )
+      _faceStart[ id + 1 ] += _faceStart[ id ];
+
+    // store faces of nodes
+    _nodeFaces.resize( _faceStart[ nbIDs ]);
+    std::vector< smIdType > pos( _faceStart.begin(), _faceStart.end() - 1 );
+    for ( size_t iF = 0; iF < faces.size(); ++iF )
+      for ( int i = 0; i < faces[ iF ]->NbNodes(); ++i )
+        _nodeFaces[ pos[ faces[ iF ]->GetNode( i )->GetID() ]++ ] = faces[ iF ];
+
+    // count distinct nodes of faces around each node
+    std::vector< int >      nbNodesAround( nbIDs, 0 );
+    std::vector< smIdType > mark( nbIDs, -1 ); // ID of the node a node is counted for
+    for ( smIdType id = 0; id < nbIDs; ++id )
+      for ( smIdType iF = _faceStart[ id ]; iF < _faceStart[ id + 1 ]; ++iF )
+      {
+        const SMDS_MeshElement* face = _nodeFaces[ iF ];
+        for ( int i = 0; i < face->NbNodes(); ++i )
+        {
+          smIdType& m = mark[ face->GetNode( i )->GetID() ];
+          if ( m != id )
+            m = id, ++nbNodesAround[ id ];
+        }
+      }
 
-    return nodesInInverseFaces.size() != ( 6 + (nbF/2-1)*3 );
+    // classify nodes by the counts
+    _isCorner.resize( nbIDs );
+    for ( smIdType id = 0; id < nbIDs; ++id )
+    {
+      int nbF = int( _faceStart[ id + 1 ] - _faceStart[ id ]);
+      _isCorner[ id ] = ( nbF % 2 ) | ( nbNodesAround[ id ] != 6 + ( nbF / 2 - 1 ) * 3 );
+    }
+  }
+
+  //================================================================================
+  /*!
+   * \brief Return a face sharing the link n1-n2 other than avoidFace, and
+   *        indices of n1 and n2 in it, as SMESH_MeshAlgos::FindFaceInSet() does.
+   *
+   * Faces of n1 are taken from the adjacency, so no set is allocated while
+   * walking a block side. A link shared by more than two faces is left to
+   * FindFaceInSet() to keep the face it chooses.
+   */
+  //================================================================================
+
+  const SMDS_MeshElement* _SkinAdjacency::findFace( const SMDS_MeshNode*    n1,
+                                                    const SMDS_MeshNode*    n2,
+                                                    const SMDS_MeshElement* avoidFace,
+                                                    int*                    i1,
+                                                    int*                    i2 ) const
+  {
+    const SMDS_MeshElement* found = 0;
+    int nbFound = 0, foundI1 = 0, foundI2 = 0;
+
+    smIdType id = n1->GetID();
+    if ( id >= 0 && id + 1 < (smIdType) _faceStart.size() )
+      for ( smIdType iF = _faceStart[ id ]; iF < _faceStart[ id + 1 ]; ++iF )
+      {
+        const SMDS_MeshElement* face = _nodeFaces[ iF ];
+        if ( face == avoidFace )
+          continue;
+        int nbN   = face->NbCornerNodes();
+        int iN1   = face->GetNodeIndex( n1 );
+        int iPrev = ( iN1 + nbN - 1 ) % nbN, iNext = ( iN1 + 1 ) % nbN;
+        int iN2   = ( face->GetNode( iPrev ) == n2 ) ? iPrev : ( face->GetNode( iNext ) == n2 ) ? iNext : -1;
+        if ( iN2 < 0 )
+          continue;
+        if ( ++nbFound > 1 )
+          break;
+        found = face, foundI1 = iN1, foundI2 = iN2;
+      }
+
+    if ( nbFound > 1 )
+    {
+      TIDSortedElemSet emptySet, avoidSet;
+      avoidSet.insert( avoidFace );
+      return SMESH_MeshAlgos::FindFaceInSet( n1, n2, emptySet, avoidSet, i1, i2 );
+    }
+    if ( i1 ) *i1 = foundI1;
+    if ( i2 ) *i2 = foundI2;
+    return found;
   }
 
   //================================================================================
@@ -142,6 +259,24 @@ namespace
     int operator()(int x, int y) const { return y * _xSize + x; }
   };
   //================================================================================
+  /*!
+   * \brief Index arithmetic of one block side orientation.
+   *
+   * Every orientation maps (x,y) to origin + x*dx + y*dy in the grid of the
+   * side; the specializations compute these coefficients at compile time
+   * from the size of the grid row (\a xSize) and the oriented sizes (\a oriX, \a oriY).
+   */
+  template< bool REVX, bool REVY, bool SWAP > struct _OriIndexTraits
+  {
+    static void affine(int xSize, int oriX, int oriY, int& origin, int& dx, int& dy)
+    {
+      const int xStep = SWAP ? xSize : 1, yStep = SWAP ? 1 : xSize;
+      dx     = REVX ? -xStep : xStep;
+      dy     = REVY ? -yStep : yStep;
+      origin = ( REVX ? (oriX-1) * xStep : 0 ) + ( REVY ? (oriY-1) * yStep : 0 );
+    }
+  };
+  //================================================================================
   /*!
    * \brief Oriented convertor of a pair of integers to a sole index 
    */
@@ -154,42 +289,37 @@ namespace
       };
     _OrientedIndexer( const _Indexer& indexer, const int oriFlags ):
       _Indexer( indexer._xSize, indexer._ySize ),
-      _xSize (indexer._xSize), _ySize(indexer._ySize),
-      _xRevFun((oriFlags & REV_X) ? & reverse : & lazy),
-      _yRevFun((oriFlags & REV_Y) ? & reverse : & lazy),
-      _swapFun((oriFlags & SWAP_XY ) ? & swap : & lazy)
+      _xSize (indexer._xSize), _ySize(indexer._ySize)
     {
-      (*_swapFun)( _xSize, _ySize );
+      if ( oriFlags & SWAP_XY ) std::swap( _xSize, _ySize );
+      const int xs = _Indexer::_xSize;
+      switch ( oriFlags & MAX_ORI ) // orientation is chosen once per side
+      {
+      case 0:                     _OriIndexTraits<false,false,false>::affine( xs, _xSize, _ySize, _origin, _dx, _dy ); break;
+      case REV_X:                 _OriIndexTraits<true, false,false>::affine( xs, _xSize, _ySize, _origin, _dx, _dy ); break;
+      case REV_Y:                 _OriIndexTraits<false,true, false>::affine( xs, _xSize, _ySize, _origin, _dx, _dy ); break;
+      case REV_X|REV_Y:           _OriIndexTraits<true, true, false>::affine( xs, _xSize, _ySize, _origin, _dx, _dy ); break;
+      case SWAP_XY:               _OriIndexTraits<false,false,true >::affine( xs, _xSize, _ySize, _origin, _dx, _dy ); break;
+      case SWAP_XY|REV_X:         _OriIndexTraits<true, false,true >::affine( xs, _xSize, _ySize, _origin, _dx, _dy ); break;
+      case SWAP_XY|REV_Y:         _OriIndexTraits<false,true, true >::affine( xs, _xSize, _ySize, _origin, _dx, _dy ); break;
+      default:                    _OriIndexTraits<true, true, true >::affine( xs, _xSize, _ySize, _origin, _dx, _dy ); break;
+      }
     }
     //!< Return index by XY
     int operator()(int x, int y) const
     {
-      (*_xRevFun)( x, const_cast<int&>( _xSize ));
-      (*_yRevFun)( y, const_cast<int&>( _ySize ));
-      (*_swapFun)( x, y );
-      return _Indexer::operator()(x,y);
+      return _origin + x * _dx + y * _dy;
     }
     //!< Return index for a corner
     int corner(bool xMax, bool yMax) const
     {
-      int x = xMax, y = yMax, size = 2;
-      (*_xRevFun)( x, size );
-      (*_yRevFun)( y, size );
-      (*_swapFun)( x, y );
-      return _Indexer::operator()(x ? _Indexer::_xSize-1 : 0 , y ? _Indexer::_ySize-1 : 0);
+      return operator()( xMax ? _xSize-1 : 0, yMax ? _ySize-1 : 0 );
     }
     int xSize() const { return _xSize; }
     int ySize() const { return _ySize; }
   private:
-    _Indexer _indexer;
-    int _xSize, _ySize;
-
-    typedef void (*TFun)(int& x, int& y);
-    TFun _xRevFun, _yRevFun, _swapFun;
-    
-    static void lazy   (int&, int&) {}
-    static void reverse(int& x, int& size) { x = size - x - 1; }
-    static void swap   (int& x, int& y) { std::swap(x,y); }
+    int _xSize, _ySize; //!< oriented sizes
+    int _origin, _dx, _dy;
   };
   //================================================================================
   /*!
@@ -354,6 +484,7 @@ namespace
 
     SMESH_Comment      _error;
 
+    _SkinAdjacency          _adjacency;
     std::list< _BlockSide > _allSides;
     std::vector< _Block >   _blocks;
 
@@ -376,11 +507,13 @@ namespace
     SMDS_NodeIteratorPtr nIt = meshDS->nodesIterator();
     if ( !nIt->more() ) return error("Empty mesh");
 
+    _adjacency.build( meshDS );
+
     const SMDS_MeshNode* nCorner = 0;
     while ( nIt->more() )
     {
       nCorner = nIt->next();
-      if ( isCornerNode( nCorner ))
+      if ( _adjacency.isCorner( nCorner ))
         break;
       else
         nCorner = 0;
@@ -440,7 +573,7 @@ namespace
         while ( nIt->more() )
         {
           nCorner = nIt->next();
-          if ( isCornerNode( nCorner ))
+          if ( _adjacency.isCorner( nCorner ))
             corner = corners.insert( corner, nCorner );
         }
         nbFacesOnSides = mesh.NbQuadrangles();
@@ -611,7 +744,6 @@ namespace
     // Find the rest nodes
 
     y = 1; // y of the row to fill
-    TIDSortedElemSet emptySet, avoidSet;
     while ( ++y < nbY )
     {
       // get next firstQuad in the next row of quadrangles
@@ -625,28 +757,24 @@ namespace
       int i1down, i2down, i2up;
       const SMDS_MeshNode* n1down = side.getNode( 0, y-1 );
       const SMDS_MeshNode* n2down = side.getNode( 1, y-1 );
-      avoidSet.clear(); avoidSet.insert( firstQuad );
-      firstQuad = SMESH_MeshAlgos::FindFaceInSet( n1down, n2down, emptySet, avoidSet,
-                                                  &i1down, &i2down);
+      firstQuad = _adjacency.findFace( n1down, n2down, firstQuad, &i1down, &i2down );
       if ( !isQuadrangle( firstQuad ))
         return BAD_MESH_ERR;
 
       const SMDS_MeshNode* n2up = oppositeNode( firstQuad, i1down );
-      avoidSet.clear(); avoidSet.insert( firstQuad );
+      const SMDS_MeshElement* quad = firstQuad;
 
       // find the rest nodes in the y-th row by faces in the row
 
       x = 1; 
       while ( ++x < nbX )
       {
-        const SMDS_MeshElement* quad = SMESH_MeshAlgos::FindFaceInSet( n2up, n2down, emptySet,
-                                                                       avoidSet, &i2up, &i2down);
+        quad = _adjacency.findFace( n2up, n2down, quad, &i2up, &i2down );
         if ( !isQuadrangle( quad ))
           return BAD_MESH_ERR;
 
         n2up   = oppositeNode( quad, i2down );
         n2down = oppositeNode( quad, i2up );
-        avoidSet.clear(); avoidSet.insert( quad );
 
         side.setNode( x, y, n2up );
       }
@@ -925,15 +1053,13 @@ namespace
       row2.push_back( n1 = oppositeNode( quad, i1 ));
     }
 
-    if ( isCornerNode( row1[1] ))
+    if ( _adjacency.isCorner( row1[1] ))
       return true;
 
     // Find the rest nodes
-    TIDSortedElemSet emptySet, avoidSet;
-    while ( !isCornerNode( n2 ) )
+    while ( !_adjacency.isCorner( n2 ) )
     {
-      avoidSet.clear(); avoidSet.insert( quad );
-      quad = SMESH_MeshAlgos::FindFaceInSet( n1, n2, emptySet, avoidSet, &i1, &i2 );
+      quad = _adjacency.findFace( n1, n2, quad, &i1, &i2 );
       if ( !isQuadrangle( quad ))
         return BAD_MESH_ERR;
 
@@ -997,62 +1123,316 @@ namespace
     return ok;
   }
 
-} // namespace
+  //================================================================================
+  /*!
+   * \brief Computes coordinates of internal nodes of a block by SMESH_Block::ShellPoint(),
+   *        in the order of x, y and z loops. Only reads the block: thread safe.
+   */
+  //================================================================================
+
+  void computeInternalPoints( const _Block& block, std::vector<gp_XYZ>& points )
+  {
+    int x, y, z;
+    int xSize = block.getSide(B_BOTTOM).getHoriSize();
+    int ySize = block.getSide(B_BOTTOM).getVertSize();
+    int zSize = block.getSide(B_FRONT ).getVertSize();
+    int X = xSize - 1, Y = ySize - 1, Z = zSize - 1;
+    points.clear();
+    if ( xSize < 3 || ySize < 3 || zSize < 3 )
+      return;
+    points.reserve( (xSize-2)*(ySize-2)*(zSize-2) );
+
+    // projection points of internal nodes on box subshapes by which
+    // coordinates of internal nodes are computed
+    std::vector<gp_XYZ> pointOnShape( SMESH_Block::ID_Shell );
+
+    // projections on vertices are constant
+    pointOnShape[ SMESH_Block::ID_V000 ] = block.getSide(B_BOTTOM).xyz( 0, 0 );
+    pointOnShape[ SMESH_Block::ID_V100 ] = block.getSide(B_BOTTOM).xyz( X, 0 );
+    pointOnShape[ SMESH_Block::ID_V010 ] = block.getSide(B_BOTTOM).xyz( 0, Y );
+    pointOnShape[ SMESH_Block::ID_V110 ] = block.getSide(B_BOTTOM).xyz( X, Y );
+    pointOnShape[ SMESH_Block::ID_V001 ] = block.getSide(B_TOP).xyz( 0, 0 );
+    pointOnShape[ SMESH_Block::ID_V101 ] = block.getSide(B_TOP).xyz( X, 0 );
+    pointOnShape[ SMESH_Block::ID_V011 ] = block.getSide(B_TOP).xyz( 0, Y );
+    pointOnShape[ SMESH_Block::ID_V111 ] = block.getSide(B_TOP).xyz( X, Y );
+
+    for ( x = 1; x < xSize-1; ++x )
+    {
+      gp_XYZ params; // normalized parameters of internal node within a unit box
+      params.SetCoord( 1, x / double(X) );
+      for ( y = 1; y < ySize-1; ++y )
+      {
+        params.SetCoord( 2, y / double(Y) );
+        // projections on horizontal edges
+        pointOnShape[ SMESH_Block::ID_Ex00 ] = block.getSide(B_BOTTOM).xyz( x, 0 );
+        pointOnShape[ SMESH_Block::ID_Ex10 ] = block.getSide(B_BOTTOM).xyz( x, Y );
+        pointOnShape[ SMESH_Block::ID_E0y0 ] = block.getSide(B_BOTTOM).xyz( 0, y );
+        pointOnShape[ SMESH_Block::ID_E1y0 ] = block.getSide(B_BOTTOM).xyz( X, y );
+        pointOnShape[ SMESH_Block::ID_Ex01 ] = block.getSide(B_TOP).xyz( x, 0 );
+        pointOnShape[ SMESH_Block::ID_Ex11 ] = block.getSide(B_TOP).xyz( x, Y );
+        pointOnShape[ SMESH_Block::ID_E0y1 ] = block.getSide(B_TOP).xyz( 0, y );
+        pointOnShape[ SMESH_Block::ID_E1y1 ] = block.getSide(B_TOP).xyz( X, y );
+        // projections on horizontal sides
+        pointOnShape[ SMESH_Block::ID_Fxy0 ] = block.getSide(B_BOTTOM).xyz( x, y );
+        pointOnShape[ SMESH_Block::ID_Fxy1 ] = block.getSide(B_TOP)   .xyz( x, y );
+        for ( z = 1; z < zSize-1; ++z ) // z loop
+        {
+          params.SetCoord( 3, z / double(Z) );
+          // projections on vertical edges
+          pointOnShape[ SMESH_Block::ID_E00z ] = block.getSide(B_FRONT).xyz( 0, z );
+          pointOnShape[ SMESH_Block::ID_E10z ] = block.getSide(B_FRONT).xyz( X, z );
+          pointOnShape[ SMESH_Block::ID_E01z ] = block.getSide(B_BACK).xyz( 0, z );
+          pointOnShape[ SMESH_Block::ID_E11z ] = block.getSide(B_BACK).xyz( X, z );
+          // projections on vertical sides
+          pointOnShape[ SMESH_Block::ID_Fx0z ] = block.getSide(B_FRONT).xyz( x, z );
+          pointOnShape[ SMESH_Block::ID_Fx1z ] = block.getSide(B_BACK) .xyz( x, z );
+          pointOnShape[ SMESH_Block::ID_F0yz ] = block.getSide(B_LEFT) .xyz( y, z );
+          pointOnShape[ SMESH_Block::ID_F1yz ] = block.getSide(B_RIGHT).xyz( y, z );
 
+          // compute internal node coordinates
+          gp_XYZ coords;
+          SMESH_Block::ShellPoint( params, pointOnShape, coords );
+          points.push_back( coords );
+        }
+      }
+    }
+  }
 
+  //================================================================================
+  /*!
+   * \brief Computes internal points of a batch of blocks, one block per call.
+   *        A block that fails is left empty, to be computed again at commit.
+   */
+  //================================================================================
 
+  struct _InternalPointsFunctor
+  {
+    const _Skin&                         _skin;
+    std::vector< std::vector<gp_XYZ> >&  _points; // of the batch
+    int                                  _first;  // block of the batch start
 
+    _InternalPointsFunctor( const _Skin& skin, std::vector< std::vector<gp_XYZ> >& points, int first ):
+      _skin( skin ), _points( points ), _first( first ) {}
 
-HEXA_NS::Hexa* _block2Hexa( const _Block& block,
-                            HEXA_NS::Document* doc,
-                            std::map<HEXA_NS::Vertex*, SMDS_MeshNode*> vertexNode )
-{
-    const SMDS_MeshNode* n000 = block.getSide(B_BOTTOM).cornerNode( 0, 0 );
-    const SMDS_MeshNode* n100 = block.getSide(B_BOTTOM).cornerNode( 1, 0 );
-    const SMDS_MeshNode* n010 = block.getSide(B_BOTTOM).cornerNode( 0, 1 );
-    const SMDS_MeshNode* n110 = block.getSide(B_BOTTOM).cornerNode( 1, 1 );
-    const SMDS_MeshNode* n001 = block.getSide(B_TOP).cornerNode( 0, 0 );
-    const SMDS_MeshNode* n101 = block.getSide(B_TOP).cornerNode( 1, 0 );
-    const SMDS_MeshNode* n011 = block.getSide(B_TOP).cornerNode( 0, 1 );
-    const SMDS_MeshNode* n111 = block.getSide(B_TOP).cornerNode( 1, 1 );
+    void operator()( int i ) const
+    {
+      try {
+        computeInternalPoints( _skin.getBlock( i ), _points[ i - _first ]);
+      }
+      catch (...) {
+        _points[ i - _first ].clear();
+      }
+    }
+  };
 
-    std::list<const SMDS_MeshNode* > nodeFromBlock;
-    nodeFromBlock.push_back(n000);
-    nodeFromBlock.push_back(n100);
-    nodeFromBlock.push_back(n010);
-    nodeFromBlock.push_back(n110);
-    nodeFromBlock.push_back(n001);
-    nodeFromBlock.push_back(n101);
-    nodeFromBlock.push_back(n011);
-    nodeFromBlock.push_back(n111);
-    nodeFromBlock.sort();
+  //================================================================================
+  /*!
+   * \brief Nodes of a block in one contiguous array, z varying fastest.
+   *        The storage is kept from block to block and only grows.
+   */
+  //================================================================================
 
+  struct _BlockNodes
+  {
+    std::vector< const SMDS_MeshNode* > _nodes;
+    int                                 _xSize, _ySize, _zSize;
 
-    HEXA_NS::Hexa* hexa = NULL;
-    int nHexa = doc->countUsedHexa();
-    for (int j=0; j <nHexa; ++j ){
-      hexa = doc->getUsedHexa(j);
-      std::list<const SMDS_MeshNode* > nodeFromHexa;
-      int nVx = hexa->countVertex();
-      for ( int i=0; i <nVx; ++i ){
-        HEXA_NS::Vertex* v = hexa->getVertex(i);
-        const SMDS_MeshNode* n = vertexNode[v];
-        nodeFromHexa.push_back(n);
+    _BlockNodes(): _xSize(0), _ySize(0), _zSize(0) {}
+    //!< Allocate storage once for the largest block of the skin
+    void reserve( const _Skin& skin, int nbBlocks )
+    {
+      size_t maxSize = 0;
+      for ( int i = 0; i < nbBlocks; ++i )
+        maxSize = std::max( maxSize, _BlockNodes::size( skin.getBlock( i )));
+      _nodes.resize( maxSize );
     }
-      nodeFromHexa.sort();
-
-      if ( nodeFromBlock == nodeFromHexa ){
-//         std::cout << "OK block match hexa "<< hexa <<" id = "<<hexa->getId()<<std::endl;
-        return hexa;
-      } /*else {
-        std::cout << "KO block does not match hexa "<< hexa <<" id = "<<hexa->getId()<<std::endl;
-      }*/
+    //!< Set dimensions of the current block
+    void reset( int xSize, int ySize, int zSize )
+    {
+      _xSize = xSize; _ySize = ySize; _zSize = zSize;
+      if ( _nodes.size() < size_t( xSize * ySize * zSize ))
+        _nodes.resize( xSize * ySize * zSize );
     }
-    return NULL;
-}
+    //!< Return the column of nodes at XY
+    const SMDS_MeshNode** column( int x, int y ) { return & _nodes[ ( x * _ySize + y ) * _zSize ]; }
 
+    static size_t size( const _Block& block )
+    {
+      return ( size_t( block.getSide(B_BOTTOM).getHoriSize() ) *
+               block.getSide(B_BOTTOM).getVertSize() *
+               block.getSide(B_FRONT ).getVertSize() );
+    }
+  };
 
+  //================================================================================
+  /*!
+   * \brief Take nodes of the block sides into the node array of the block
+   */
+  //================================================================================
 
+  void fillSkinNodes( const _Block& block, _BlockNodes& nodes )
+  {
+    int x, y, z;
+    int xSize = block.getSide(B_BOTTOM).getHoriSize();
+    int ySize = block.getSide(B_BOTTOM).getVertSize();
+    int zSize = block.getSide(B_FRONT ).getVertSize();
+    int X = xSize - 1, Y = ySize - 1;
+    nodes.reset( xSize, ySize, zSize );
+
+    // front and back box sides
+    for ( x = 0; x < xSize; ++x ) {
+      const SMDS_MeshNode** column0 = nodes.column( x, 0 );
+      const SMDS_MeshNode** column1 = nodes.column( x, Y );
+      for ( z = 0; z < zSize; ++z ) {
+        column0[ z ] = block.getSide(B_FRONT).node( x, z );
+        column1[ z ] = block.getSide(B_BACK) .node( x, z );
+      }
+    }
+    // left and right box sides
+    for ( y = 1; y < ySize-1; ++y ) {
+      const SMDS_MeshNode** column0 = nodes.column( 0, y );
+      const SMDS_MeshNode** column1 = nodes.column( X, y );
+      for ( z = 0; z < zSize; ++z ) {
+        column0[ z ] = block.getSide(B_LEFT) .node( y, z );
+        column1[ z ] = block.getSide(B_RIGHT).node( y, z );
+      }
+    }
+    // top and bottom box sides
+    for ( x = 1; x < xSize-1; ++x )
+      for ( y = 1; y < ySize-1; ++y ) {
+        const SMDS_MeshNode** column = nodes.column( x, y );
+        column[ 0 ]       = block.getSide(B_BOTTOM).node( x, y );
+        column[ zSize-1 ] = block.getSide(B_TOP)   .node( x, y );
+      }
+  }
+
+  //================================================================================
+  /*!
+   * \brief Adds internal nodes of the blocks of a skin. In parallel mode, their
+   *        coordinates are computed for a batch of blocks at once.
+   */
+  //================================================================================
+
+  class _InternalNodes
+  {
+  public:
+    _InternalNodes( const _Skin& skin, int nbBlocks, bool parallel ):
+      _skin( skin ), _nbBlocks( nbBlocks ), _parallel( parallel ) {}
+
+    void add( int iBlock, _BlockNodes& nodes, SMESH_MesherHelper* helper );
+
+  private:
+    const _Skin&                       _skin;
+    int                                _nbBlocks;
+    bool                               _parallel;
+    std::vector< std::vector<gp_XYZ> > _batchPoints;
+    std::vector<gp_XYZ>                _serialPoints;
+  };
+
+  //================================================================================
+  /*!
+   * \brief Adds internal nodes of a block to its node array, filled by
+   *        fillSkinNodes(). Blocks must come in increasing order.
+   */
+  //================================================================================
+
+  void _InternalNodes::add( int iBlock, _BlockNodes& nodes, SMESH_MesherHelper* helper )
+  {
+    if ( _parallel && iBlock % HEXA_POINTS_BATCH == 0 )
+    {
+      int nbBatch = std::min( HEXA_POINTS_BATCH, _nbBlocks - iBlock );
+      _batchPoints.assign( nbBatch, std::vector<gp_XYZ>() );
+      OSD_Parallel::For( iBlock, iBlock + nbBatch, _InternalPointsFunctor( _skin, _batchPoints, iBlock ));
+    }
+    // coordinates computed in parallel, or else now
+    std::vector<gp_XYZ>& points =
+      _parallel ? _batchPoints[ iBlock % HEXA_POINTS_BATCH ] : _serialPoints;
+    if ( points.empty() )
+      computeInternalPoints( _skin.getBlock( iBlock ), points );
+
+    size_t iPoint = 0;
+    for ( int x = 1; x < nodes._xSize-1; ++x )
+      for ( int y = 1; y < nodes._ySize-1; ++y )
+      {
+        const SMDS_MeshNode** column = nodes.column( x, y );
+        for ( int z = 1; z < nodes._zSize-1; ++z, ++iPoint )
+          column[ z ] = helper->AddNode( points[iPoint].X(), points[iPoint].Y(), points[iPoint].Z() );
+      }
+
+    if ( _parallel )
+      std::vector<gp_XYZ>().swap( points ); // the batch is not kept
+    else
+      points.clear();
+  }
+
+  //================================================================================
+  /*!
+   * \brief Sorted corner nodes of a block or of a hexa, to match them
+   */
+  //================================================================================
+
+  struct _CornerSignature
+  {
+    const SMDS_MeshNode* _nodes[8];
+
+    bool operator<( const _CornerSignature& other ) const
+    {
+      return std::lexicographical_compare( _nodes, _nodes + 8, other._nodes, other._nodes + 8 );
+    }
+  };
+  typedef std::map< _CornerSignature, HEXA_NS::Hexa* > _HexaIndex;
+
+  //================================================================================
+  /*!
+   * \brief Index of the hexas of the document by their corner nodes, built once
+   *        per compute. The first hexa is kept if several have the same corners.
+   */
+  //================================================================================
+
+  void _indexHexas( HEXA_NS::Document* doc,
+                    const std::map<HEXA_NS::Vertex*, SMDS_MeshNode*>& vertexNode,
+                    _HexaIndex& hexaIndex )
+  {
+    int nHexa = doc->countUsedHexa();
+    for ( int j = 0; j < nHexa; ++j ){
+      HEXA_NS::Hexa* hexa = doc->getUsedHexa(j);
+      if ( hexa->countVertex() != 8 )
+        continue;
+      _CornerSignature signature;
+      for ( int i = 0; i < 8; ++i ){
+        std::map<HEXA_NS::Vertex*, SMDS_MeshNode*>::const_iterator n =
+          vertexNode.find( hexa->getVertex(i) );
+        signature._nodes[i] = ( n == vertexNode.end() ) ? 0 : n->second;
+      }
+      std::sort( signature._nodes, signature._nodes + 8 );
+      hexaIndex.insert( std::make_pair( signature, hexa ));
+    }
+  }
+
+  //================================================================================
+  /*!
+   * \brief Return the hexa of the document having the corners of a block, if any
+   */
+  //================================================================================
+
+  HEXA_NS::Hexa* _block2Hexa( const _Block& block, const _HexaIndex& hexaIndex )
+  {
+    _CornerSignature signature;
+    signature._nodes[0] = block.getSide(B_BOTTOM).cornerNode( 0, 0 );
+    signature._nodes[1] = block.getSide(B_BOTTOM).cornerNode( 1, 0 );
+    signature._nodes[2] = block.getSide(B_BOTTOM).cornerNode( 0, 1 );
+    signature._nodes[3] = block.getSide(B_BOTTOM).cornerNode( 1, 1 );
+    signature._nodes[4] = block.getSide(B_TOP).cornerNode( 0, 0 );
+    signature._nodes[5] = block.getSide(B_TOP).cornerNode( 1, 0 );
+    signature._nodes[6] = block.getSide(B_TOP).cornerNode( 0, 1 );
+    signature._nodes[7] = block.getSide(B_TOP).cornerNode( 1, 1 );
+    std::sort( signature._nodes, signature._nodes + 8 );
+
+    _HexaIndex::const_iterator found = hexaIndex.find( signature );
+    return ( found == hexaIndex.end() ) ? NULL : found->second;
+  }
+
+} // namespace
 
 
 
@@ -1072,7 +1452,8 @@ HEXA_NS::Hexa* _block2Hexa( const _Block& block,
 
 SMESH_HexaFromSkin_3D::SMESH_HexaFromSkin_3D(int hypId, SMESH_Gen* gen, HEXA_NS::Document* doc)
   :SMESH_3D_Algo(hypId, gen),
-  _doc( doc )
+  _doc( doc ),
+  _parallel( true )
 {
   MESSAGE("SMESH_HexaFromSkin_3D::SMESH_HexaFromSkin_3D");
   _name = "HexaFromSkin_3D";
@@ -1097,128 +1478,30 @@ bool SMESH_HexaFromSkin_3D::Compute(SMESH_Mesh & aMesh, SMESH_MesherHelper* aHel
   if ( nbBlocks == 0 )
     return error( skin.error());
 
-  std::vector< std::vector< const SMDS_MeshNode* > > columns;
+  _BlockNodes nodes;
+  nodes.reserve( skin, nbBlocks );
   int x, xSize, y, ySize, z, zSize;
-  _Indexer colIndex;
+
+  _InternalNodes internalNodes( skin, nbBlocks, _parallel );
 
   for ( int i = 0; i < nbBlocks; ++i )
   {
     const _Block& block = skin.getBlock( i );
 
-    // ------------------------------------------
-    // Fill columns of nodes with existing nodes
-    // ------------------------------------------
+    // --------------------------------------
+    // Fill block nodes with existing nodes
+    // --------------------------------------
 
     xSize = block.getSide(B_BOTTOM).getHoriSize();
     ySize = block.getSide(B_BOTTOM).getVertSize();
     zSize = block.getSide(B_FRONT ).getVertSize();
-    int X = xSize - 1, Y = ySize - 1, Z = zSize - 1;
-    colIndex = _Indexer( xSize, ySize );
-    columns.resize( colIndex.size() );
-
-    // fill node columns by front and back box sides
-    for ( x = 0; x < xSize; ++x ) {
-      std::vector< const SMDS_MeshNode* >& column0 = columns[ colIndex( x, 0 )];
-      std::vector< const SMDS_MeshNode* >& column1 = columns[ colIndex( x, Y )];
-      column0.resize( zSize );
-      column1.resize( zSize );
-      for ( z = 0; z < zSize; ++z ) {
-        column0[ z ] = block.getSide(B_FRONT).node( x, z );
-        column1[ z ] = block.getSide(B_BACK) .node( x, z );
-      }
-    }
-    // fill node columns by left and right box sides
-    for ( y = 1; y < ySize-1; ++y ) {
-      std::vector< const SMDS_MeshNode* >& column0 = columns[ colIndex( 0, y )];
-      std::vector< const SMDS_MeshNode* >& column1 = columns[ colIndex( X, y )];
-      column0.resize( zSize );
-      column1.resize( zSize );
-      for ( z = 0; z < zSize; ++z ) {
-        column0[ z ] = block.getSide(B_LEFT) .node( y, z );
-        column1[ z ] = block.getSide(B_RIGHT).node( y, z );
-      }
-    }
-    // get nodes from top and bottom box sides
-    for ( x = 1; x < xSize-1; ++x ) {
-      for ( y = 1; y < ySize-1; ++y ) {
-        std::vector< const SMDS_MeshNode* >& column = columns[ colIndex( x, y )];
-        column.resize( zSize );
-        column.front() = block.getSide(B_BOTTOM).node( x, y );
-        column.back()  = block.getSide(B_TOP)   .node( x, y );
-      }
-    }
+    fillSkinNodes( block, nodes );
 
     // ----------------------------
     // Add internal nodes of a box
     // ----------------------------
-    // projection points of internal nodes on box sub-shapes by which
-    // coordinates of internal nodes are computed
-    std::vector<gp_XYZ> pointOnShape( SMESH_Block::ID_Shell );
+    internalNodes.add( i, nodes, aHelper );
 
-    // projections on vertices are constant
-    pointOnShape[ SMESH_Block::ID_V000 ] = block.getSide(B_BOTTOM).xyz( 0, 0 );
-    pointOnShape[ SMESH_Block::ID_V100 ] = block.getSide(B_BOTTOM).xyz( X, 0 );
-    pointOnShape[ SMESH_Block::ID_V010 ] = block.getSide(B_BOTTOM).xyz( 0, Y );
-    pointOnShape[ SMESH_Block::ID_V110 ] = block.getSide(B_BOTTOM).xyz( X, Y );
-    pointOnShape[ SMESH_Block::ID_V001 ] = block.getSide(B_TOP).xyz( 0, 0 );
-    pointOnShape[ SMESH_Block::ID_V101 ] = block.getSide(B_TOP).xyz( X, 0 );
-    pointOnShape[ SMESH_Block::ID_V011 ] = block.getSide(B_TOP).xyz( 0, Y );
-    pointOnShape[ SMESH_Block::ID_V111 ] = block.getSide(B_TOP).xyz( X, Y );
-
-    for ( x = 1; x < xSize-1; ++x )
-    {
-      gp_XYZ params; // normalized parameters of internal node within a unit box
-      params.SetCoord( 1, x / double(X) );
-      for ( y = 1; y < ySize-1; ++y )
-      {
-        params.SetCoord( 2, y / double(Y) );
-        // column to fill during z loop
-        std::vector< const SMDS_MeshNode* >& column = columns[ colIndex( x, y )];
-        // projections on horizontal edges
-        pointOnShape[ SMESH_Block::ID_Ex00 ] = block.getSide(B_BOTTOM).xyz( x, 0 );
-        pointOnShape[ SMESH_Block::ID_Ex10 ] = block.getSide(B_BOTTOM).xyz( x, Y );
-        pointOnShape[ SMESH_Block::ID_E0y0 ] = block.getSide(B_BOTTOM).xyz( 0, y );
-        pointOnShape[ SMESH_Block::ID_E1y0 ] = block.getSide(B_BOTTOM).xyz( X, y );
-        pointOnShape[ SMESH_Block::ID_Ex01 ] = block.getSide(B_TOP).xyz( x, 0 );
-        pointOnShape[ SMESH_Block::ID_Ex11 ] = block.getSide(B_TOP).xyz( x, Y );
-        pointOnShape[ SMESH_Block::ID_E0y1 ] = block.getSide(B_TOP).xyz( 0, y );
-        pointOnShape[ SMESH_Block::ID_E1y1 ] = block.getSide(B_TOP).xyz( X, y );
-        // projections on horizontal sides
-        pointOnShape[ SMESH_Block::ID_Fxy0 ] = block.getSide(B_BOTTOM).xyz( x, y );
-        pointOnShape[ SMESH_Block::ID_Fxy1 ] = block.getSide(B_TOP)   .xyz( x, y );
-        for ( z = 1; z < zSize-1; ++z ) // z loop
-        {
-          params.SetCoord( 3, z / double(Z) );
-          // projections on vertical edges
-          pointOnShape[ SMESH_Block::ID_E00z ] = block.getSide(B_FRONT).xyz( 0, z );    
-          pointOnShape[ SMESH_Block::ID_E10z ] = block.getSide(B_FRONT).xyz( X, z );    
-          pointOnShape[ SMESH_Block::ID_E01z ] = block.getSide(B_BACK).xyz( 0, z );    
-          pointOnShape[ SMESH_Block::ID_E11z ] = block.getSide(B_BACK).xyz( X, z );
-          // projections on vertical sides
-          pointOnShape[ SMESH_Block::ID_Fx0z ] = block.getSide(B_FRONT).xyz( x, z );    
-          pointOnShape[ SMESH_Block::ID_Fx1z ] = block.getSide(B_BACK) .xyz( x, z );    
-          pointOnShape[ SMESH_Block::ID_F0yz ] = block.getSide(B_LEFT) .xyz( y, z );    
-          pointOnShape[ SMESH_Block::ID_F1yz ] = block.getSide(B_RIGHT).xyz( y, z );
-
-          // compute internal node coordinates
-          gp_XYZ coords;
-          SMESH_Block::ShellPoint( params, pointOnShape, coords );
-          column[ z ] = aHelper->AddNode( coords.X(), coords.Y(), coords.Z() );
-
-#ifdef DEB_GRID
-          // debug
-          //cout << "----------------------------------------------------------------------"<<endl;
-          //for ( int id = SMESH_Block::ID_V000; id < SMESH_Block::ID_Shell; ++id)
-          //{
-          //  gp_XYZ p = pointOnShape[ id ];
-          //  SMESH_Block::DumpShapeID( id,cout)<<" ( "<<p.X()<<", "<<p.Y()<<", "<<p.Z()<<" )"<<endl;
-          //}
-          //cout << "Params: ( "<< params.X()<<", "<<params.Y()<<", "<<params.Z()<<" )"<<endl;
-          //cout << "coords: ( "<< coords.X()<<", "<<coords.Y()<<", "<<coords.Z()<<" )"<<endl;
-#endif
-        }
-      }
-    }
     // ----------------
     // Add hexahedrons
     // ----------------
@@ -1234,10 +1517,10 @@ bool SMESH_HexaFromSkin_3D::Compute(SMESH_Mesh & aMesh, SMESH_MesherHelper* aHel
           x = xMax ? xSize-1 : 1;
           y = yMax ? ySize-1 : 1;
           z = zMax ? zSize-1 : 1;
-          std::vector< const SMDS_MeshNode* >& col00 = columns[ colIndex( x-1, y-1 )];
-          std::vector< const SMDS_MeshNode* >& col10 = columns[ colIndex( x  , y-1 )];
-          std::vector< const SMDS_MeshNode* >& col01 = columns[ colIndex( x-1, y   )];
-          std::vector< const SMDS_MeshNode* >& col11 = columns[ colIndex( x  , y )];
+          const SMDS_MeshNode** col00 = nodes.column( x-1, y-1 );
+          const SMDS_MeshNode** col10 = nodes.column( x  , y-1 );
+          const SMDS_MeshNode** col01 = nodes.column( x-1, y   );
+          const SMDS_MeshNode** col11 = nodes.column( x  , y   );
           
           const SMDS_MeshNode* n000 = col00[z-1];
           const SMDS_MeshNode* n100 = col10[z-1];
@@ -1270,10 +1553,10 @@ bool SMESH_HexaFromSkin_3D::Compute(SMESH_Mesh & aMesh, SMESH_MesherHelper* aHel
     // add elements
     for ( x = 0; x < xSize-1; ++x ) {
       for ( y = 0; y < ySize-1; ++y ) {
-        std::vector< const SMDS_MeshNode* >& col00 = columns[ colIndex( x, y )];
-        std::vector< const SMDS_MeshNode* >& col10 = columns[ colIndex( x+1, y )];
-        std::vector< const SMDS_MeshNode* >& col01 = columns[ colIndex( x, y+1 )];
-        std::vector< const SMDS_MeshNode* >& col11 = columns[ colIndex( x+1, y+1 )];
+        const SMDS_MeshNode** col00 = nodes.column( x, y );
+        const SMDS_MeshNode** col10 = nodes.column( x+1, y );
+        const SMDS_MeshNode** col01 = nodes.column( x, y+1 );
+        const SMDS_MeshNode** col11 = nodes.column( x+1, y+1 );
         // bottom face normal of a hexa mush point outside the volume
         if ( isForw )
           for ( z = 0; z < zSize-1; ++z )
@@ -1298,7 +1581,7 @@ bool SMESH_HexaFromSkin_3D::Compute(SMESH_Mesh & aMesh, SMESH_MesherHelper* aHel
 //================================================================================
 bool SMESH_HexaFromSkin_3D::Compute( SMESH_Mesh & aMesh, SMESH_MesherHelper* aHelper,
       std::map<HEXA_NS::Hexa*, SMESH_HexaBlocks::SMESHVolumes>& volumesOnHexa,
-      std::map<HEXA_NS::Vertex*, SMDS_MeshNode*> vertexNode )
+      const std::map<HEXA_NS::Vertex*, SMDS_MeshNode*>& vertexNode )
           {
   MESSAGE("SMESH_HexaFromSkin_3D::Compute BEGIN");
   _Skin skin;
@@ -1306,128 +1589,33 @@ bool SMESH_HexaFromSkin_3D::Compute( SMESH_Mesh & aMesh, SMESH_MesherHelper* aHe
   if ( nbBlocks == 0 )
     return error( skin.error());
 
-  std::vector< std::vector< const SMDS_MeshNode* > > columns;
+  _HexaIndex hexaIndex;
+  _indexHexas( _doc, vertexNode, hexaIndex );
+
+  _BlockNodes nodes;
+  nodes.reserve( skin, nbBlocks );
   int x, xSize, y, ySize, z, zSize;
-  _Indexer colIndex;
+
+  _InternalNodes internalNodes( skin, nbBlocks, _parallel );
 
   for ( int i = 0; i < nbBlocks; ++i )
   {
     const _Block& block = skin.getBlock( i );
 
-    // ------------------------------------------
-    // Fill columns of nodes with existing nodes
-    // ------------------------------------------
+    // --------------------------------------
+    // Fill block nodes with existing nodes
+    // --------------------------------------
 
     xSize = block.getSide(B_BOTTOM).getHoriSize();
     ySize = block.getSide(B_BOTTOM).getVertSize();
     zSize = block.getSide(B_FRONT ).getVertSize();
-    int X = xSize - 1, Y = ySize - 1, Z = zSize - 1;
-    colIndex = _Indexer( xSize, ySize );
-    columns.resize( colIndex.size() );
-
-    // fill node columns by front and back box sides
-    for ( x = 0; x < xSize; ++x ) {
-      std::vector< const SMDS_MeshNode* >& column0 = columns[ colIndex( x, 0 )];
-      std::vector< const SMDS_MeshNode* >& column1 = columns[ colIndex( x, Y )];
-      column0.resize( zSize );
-      column1.resize( zSize );
-      for ( z = 0; z < zSize; ++z ) {
-        column0[ z ] = block.getSide(B_FRONT).node( x, z );
-        column1[ z ] = block.getSide(B_BACK) .node( x, z );
-          }
-    }
-    // fill node columns by left and right box sides
-    for ( y = 1; y < ySize-1; ++y ) {
-      std::vector< const SMDS_MeshNode* >& column0 = columns[ colIndex( 0, y )];
-      std::vector< const SMDS_MeshNode* >& column1 = columns[ colIndex( X, y )];
-      column0.resize( zSize );
-      column1.resize( zSize );
-      for ( z = 0; z < zSize; ++z ) {
-        column0[ z ] = block.getSide(B_LEFT) .node( y, z );
-        column1[ z ] = block.getSide(B_RIGHT).node( y, z );
-      }
-    }
-    // get nodes from top and bottom box sides
-    for ( x = 1; x < xSize-1; ++x ) {
-      for ( y = 1; y < ySize-1; ++y ) {
-        std::vector< const SMDS_MeshNode* >& column = columns[ colIndex( x, y )];
-        column.resize( zSize );
-        column.front() = block.getSide(B_BOTTOM).node( x, y );
-        column.back()  = block.getSide(B_TOP)   .node( x, y );
-      }
-    }
+    fillSkinNodes( block, nodes );
 
     // ----------------------------
     // Add internal nodes of a box
     // ----------------------------
-    // projection points of internal nodes on box subshapes by which
-    // coordinates of internal nodes are computed
-    std::vector<gp_XYZ> pointOnShape( SMESH_Block::ID_Shell );
+    internalNodes.add( i, nodes, aHelper );
 
-    // projections on vertices are constant
-    pointOnShape[ SMESH_Block::ID_V000 ] = block.getSide(B_BOTTOM).xyz( 0, 0 );
-    pointOnShape[ SMESH_Block::ID_V100 ] = block.getSide(B_BOTTOM).xyz( X, 0 );
-    pointOnShape[ SMESH_Block::ID_V010 ] = block.getSide(B_BOTTOM).xyz( 0, Y );
-    pointOnShape[ SMESH_Block::ID_V110 ] = block.getSide(B_BOTTOM).xyz( X, Y );
-    pointOnShape[ SMESH_Block::ID_V001 ] = block.getSide(B_TOP).xyz( 0, 0 );
-    pointOnShape[ SMESH_Block::ID_V101 ] = block.getSide(B_TOP).xyz( X, 0 );
-    pointOnShape[ SMESH_Block::ID_V011 ] = block.getSide(B_TOP).xyz( 0, Y );
-    pointOnShape[ SMESH_Block::ID_V111 ] = block.getSide(B_TOP).xyz( X, Y );
-
-    for ( x = 1; x < xSize-1; ++x )
-          {
-      gp_XYZ params; // normalized parameters of internal node within a unit box
-      params.SetCoord( 1, x / double(X) );
-      for ( y = 1; y < ySize-1; ++y )
-      {
-        params.SetCoord( 2, y / double(Y) );
-        // column to fill during z loop
-        std::vector< const SMDS_MeshNode* >& column = columns[ colIndex( x, y )];
-        // projections on horizontal edges
-        pointOnShape[ SMESH_Block::ID_Ex00 ] = block.getSide(B_BOTTOM).xyz( x, 0 );
-        pointOnShape[ SMESH_Block::ID_Ex10 ] = block.getSide(B_BOTTOM).xyz( x, Y );
-        pointOnShape[ SMESH_Block::ID_E0y0 ] = block.getSide(B_BOTTOM).xyz( 0, y );
-        pointOnShape[ SMESH_Block::ID_E1y0 ] = block.getSide(B_BOTTOM).xyz( X, y );
-        pointOnShape[ SMESH_Block::ID_Ex01 ] = block.getSide(B_TOP).xyz( x, 0 );
-        pointOnShape[ SMESH_Block::ID_Ex11 ] = block.getSide(B_TOP).xyz( x, Y );
-        pointOnShape[ SMESH_Block::ID_E0y1 ] = block.getSide(B_TOP).xyz( 0, y );
-        pointOnShape[ SMESH_Block::ID_E1y1 ] = block.getSide(B_TOP).xyz( X, y );
-        // projections on horizontal sides
-        pointOnShape[ SMESH_Block::ID_Fxy0 ] = block.getSide(B_BOTTOM).xyz( x, y );
-        pointOnShape[ SMESH_Block::ID_Fxy1 ] = block.getSide(B_TOP)   .xyz( x, y );
-        for ( z = 1; z < zSize-1; ++z ) // z loop
-        {
-          params.SetCoord( 3, z / double(Z) );
-          // projections on vertical edges
-          pointOnShape[ SMESH_Block::ID_E00z ] = block.getSide(B_FRONT).xyz( 0, z );    
-          pointOnShape[ SMESH_Block::ID_E10z ] = block.getSide(B_FRONT).xyz( X, z );    
-          pointOnShape[ SMESH_Block::ID_E01z ] = block.getSide(B_BACK).xyz( 0, z );    
-          pointOnShape[ SMESH_Block::ID_E11z ] = block.getSide(B_BACK).xyz( X, z );
-          // projections on vertical sides
-          pointOnShape[ SMESH_Block::ID_Fx0z ] = block.getSide(B_FRONT).xyz( x, z );    
-          pointOnShape[ SMESH_Block::ID_Fx1z ] = block.getSide(B_BACK) .xyz( x, z );    
-          pointOnShape[ SMESH_Block::ID_F0yz ] = block.getSide(B_LEFT) .xyz( y, z );    
-          pointOnShape[ SMESH_Block::ID_F1yz ] = block.getSide(B_RIGHT).xyz( y, z );
-
-          // compute internal node coordinates
-          gp_XYZ coords;
-          SMESH_Block::ShellPoint( params, pointOnShape, coords );
-          column[ z ] = aHelper->AddNode( coords.X(), coords.Y(), coords.Z() );
-
-#ifdef DEB_GRID
-          // debug
-          //cout << "----------------------------------------------------------------------"<<endl;
-          //for ( int id = SMESH_Block::ID_V000; id < SMESH_Block::ID_Shell; ++id)
-          //{
-          //  gp_XYZ p = pointOnShape[ id ];
-          //  SMESH_Block::DumpShapeID( id,cout)<<" ( "<<p.X()<<", "<<p.Y()<<", "<<p.Z()<<" )"<<endl;
-          //}
-          //cout << "Params: ( "<< params.X()<<", "<<params.Y()<<", "<<params.Z()<<" )"<<endl;
-          //cout << "coords: ( "<< coords.X()<<", "<<coords.Y()<<", "<<coords.Z()<<" )"<<endl;
-#endif
-          }
-        }
-    }
     // ----------------
     // Add hexahedrons
     // ----------------
@@ -1447,13 +1635,14 @@ bool SMESH_HexaFromSkin_3D::Compute( SMESH_Mesh & aMesh, SMESH_MesherHelper* aHe
 
     // add elements
     SMESH_HexaBlocks::SMESHVolumes volumesOnBlock; //Groups creation
+    volumesOnBlock.reserve( (xSize-1)*(ySize-1)*(zSize-1) );
 
     for ( x = 0; x < xSize-1; ++x ) {
       for ( y = 0; y < ySize-1; ++y ) {
-        std::vector< const SMDS_MeshNode* >& col00 = columns[ colIndex( x, y )];
-        std::vector< const SMDS_MeshNode* >& col10 = columns[ colIndex( x+1, y )];
-        std::vector< const SMDS_MeshNode* >& col01 = columns[ colIndex( x, y+1 )];
-        std::vector< const SMDS_MeshNode* >& col11 = columns[ colIndex( x+1, y+1 )];
+        const SMDS_MeshNode** col00 = nodes.column( x, y );
+        const SMDS_MeshNode** col10 = nodes.column( x+1, y );
+        const SMDS_MeshNode** col01 = nodes.column( x, y+1 );
+        const SMDS_MeshNode** col11 = nodes.column( x+1, y+1 );
         // bottom face normal of a hexa mush point outside the volume
         if ( isForw )
           for ( z = 0; z < zSize-1; ++z ){
@@ -1472,7 +1661,7 @@ bool SMESH_HexaFromSkin_3D::Compute( SMESH_Mesh & aMesh, SMESH_MesherHelper* aHe
     }
     }
 //     std::cout << "block i = " << i << std::endl;
-    HEXA_NS::Hexa* currentHexa = _block2Hexa( block, _doc, vertexNode );
+    HEXA_NS::Hexa* currentHexa = _block2Hexa( block, hexaIndex );
     if ( currentHexa != NULL ){
 //       std::cout<<"===== found ->"<<currentHexa<<" for block "<<i<<std::endl;
       if ( volumesOnHexa.count(currentHexa)==0 ) {
@@ -51,7 +51,7 @@ public:
   virtual bool Compute(SMESH_Mesh & aMesh, SMESH_MesherHelper* aHelper);
   virtual bool Compute(SMESH_Mesh & aMesh, SMESH_MesherHelper* aHelper,
       std::map<HEXA_NS::Hexa*, SMESH_HexaBlocks::SMESHVolumes>& volumesOnHexa,
-      std::map<HEXA_NS::Vertex*, SMDS_MeshNode*> vertexNode );
+      const std::map<HEXA_NS::Vertex*, SMDS_MeshNode*>& vertexNode );
 
   virtual bool CheckHypothesis(SMESH_Mesh& aMesh,
                                const TopoDS_Shape& aShape,
@@ -63,8 +63,13 @@ public:
                         const TopoDS_Shape & aShape,
                         MapShapeNbElems&     aResMap);
 
+  // Internal nodes of the blocks are computed on all the cores before
+  // they are added to the mesh ( same mesh as in serial mode )
+  void SetParallel( bool parallel ) { _parallel = parallel; }
+
 private:
   HEXA_NS::Document*  _doc;
+  bool                _parallel;
 
 };
 
@@ -178,7 +178,31 @@ bool HEXABLOCKPlugin_HEXABLOCK::Evaluate(SMESH_Mesh& aMesh,
                                  const TopoDS_Shape& aShape,
                                  MapShapeNbElems& aResMap)
 {
-  MESSAGE("HEXABLOCKPlugin_HEXABLOCK::Evaluate: do nothing");
+  MESSAGE("HEXABLOCKPlugin_HEXABLOCK::Evaluate");
+
+  if ( !_hyp ) {
+    Hypothesis_Status aStatus;
+    CheckHypothesis( aMesh, aShape, aStatus );
+  }
+  if ( !_hyp )
+    return false;
+
+  std::vector<smIdType>& nbByType = aResMap[ aMesh.GetSubMesh( aShape )];
+  if ( nbByType.size() < SMDSEntity_Last )
+    nbByType.resize( SMDSEntity_Last, 0 );
+
+  // the whole document is meshed with the last solid ( see Compute() ):
+  // it is counted with the first one only
+  TopExp_Explorer expShape ( aMesh.GetMeshDS()->ShapeToMesh(), TopAbs_SOLID );
+  if ( expShape.More() && !expShape.Current().IsSame( aShape ))
+    return true;
+
+  SMESH_HexaBlocks::Counts counts =
+    SMESH_HexaBlocks::countDoc( _hyp->GetDocument(), _hyp->GetDimension() );
+  nbByType[ SMDSEntity_Node ]       += counts.nbNodes;
+  nbByType[ SMDSEntity_Edge ]       += counts.nbEdges;
+  nbByType[ SMDSEntity_Quadrangle ] += counts.nbQuads;
+  nbByType[ SMDSEntity_Hexa ]       += counts.nbHexas;
 
   return true;
 }
@@ -228,36 +252,10 @@ bool HEXABLOCKPlugin_HEXABLOCK::Compute2D(SMESH_Mesh& theMesh)
   };
 
   // B) Edges computation
-  int nbPropa = 0;
-  HEXA_NS::Propagation* propa = NULL;
-  HEXA_NS::Law*         law   = NULL;
-  HEXA_NS::Edges        edges;
-
-  nbPropa = doc->countPropagation();
-  for (int j=0; j < nbPropa; ++j ){ //Computing each edge's propagations of the document
-    propa = doc->getPropagation(j);
-    edges = propa->getEdges();
-    law   = propa->getLaw();
-    if (law == NULL){
-      law = doc->getLaw(0); // default law
-    };
-    for( HEXA_NS::Edges::const_iterator iter = edges.begin(); iter != edges.end(); ++iter ) {
-      hexaBuilder.computeEdge(**iter, *law);
-    };
-  };
+  hexaBuilder.computeEdges(doc);
 
   // C) Quad computation
-  std::map<HEXA_NS::Quad*, bool>  quadWays = hexaBuilder.computeQuadWays(doc);
-  int nQuad = doc->countUsedQuad();
-  HEXA_NS::Quad* quad = NULL;
-  for (int j=0; j <nQuad; ++j ){ //Computing each quad of the document
-    quad = doc->getUsedQuad(j);
-    int id = quad->getId();
-    if ( quadWays.count(quad) > 0 )
-      hexaBuilder.computeQuad(*quad, quadWays[quad]);
-    else
-      MESSAGE("NO QUAD WAY ID = "<<id);
-  };
+  hexaBuilder.computeQuads(doc);
 
   // D) build Groups
   hexaBuilder.buildGroups(doc);
@@ -351,24 +349,7 @@ bool HEXABLOCKPlugin_HEXABLOCK::Compute1D(SMESH_Mesh& theMesh)
   };
 
   // B) Edges computation
-  int nbPropa = 0;
-  HEXA_NS::Propagation* propa = NULL;
-  HEXA_NS::Law*         law   = NULL;
-  HEXA_NS::Edges        edges;
-
-  nbPropa = doc->countPropagation();
-  for (int j=0; j < nbPropa; ++j ){//Computing each edge's propagations of the document
-    propa = doc->getPropagation(j);
-    edges = propa->getEdges();
-    law   = propa->getLaw();
-    //         ASSERT( law );
-    if (law == NULL){
-      law = doc->getLaw(0); // default law
-    };
-    for( HEXA_NS::Edges::const_iterator iter = edges.begin(); iter != edges.end(); ++iter ) {
-      hexaBuilder.computeEdge(**iter, *law);
-    };
-  };
+  hexaBuilder.computeEdges(doc);
 
   // C) build Groups
   hexaBuilder.buildGroups(doc);
@@ -23,6 +23,8 @@
 
 #include <sstream>
 #include <algorithm>
+#include <iterator>
+#include <deque>
 
 // CasCade includes
 
@@ -31,7 +33,6 @@
 #include <BRepTools.hxx>
 #include <BRep_Builder.hxx>
 #include <BRepAdaptor_Curve.hxx>
-#include <BRepBuilderAPI_MakeFace.hxx>
 
 #include <GeomConvert_CompCurveToBSplineCurve.hxx>
 #include <GCPnts_AbscissaPoint.hxx>
@@ -40,15 +41,27 @@
 #include <TopoDS.hxx>
 #include <TopoDS_Shape.hxx>
 #include <TopoDS_Compound.hxx>
-#include <gp_Pln.hxx>
+#include <gp.hxx>
 #include <gp_Pnt.hxx>
 #include <gp_Dir.hxx>
 #include <gp_Lin.hxx>
 #include <IntCurvesFace_ShapeIntersector.hxx>
+#include <ShapeAnalysis_Surface.hxx>
+#include <BRepClass_FaceClassifier.hxx>
+#include <Geom_Surface.hxx>
+#include <Bnd_Box.hxx>
+#include <BRepBndLib.hxx>
+#include <TopExp.hxx>
+#include <TopTools_IndexedMapOfShape.hxx>
+#include <OSD_Parallel.hxx>
+#include <OSD_ThreadPool.hxx>
 
 // SMESH includes
 #include "SMDS_MeshNode.hxx"
 #include "SMDS_MeshVolume.hxx"
+#include "SMDS_VolumeOfNodes.hxx"
+#include "SMDS_VolumeTool.hxx"
+#include "SMESH_Block.hxx"
 #include "SMESH_Gen.hxx"
 #include "SMESH_MesherHelper.hxx"
 #include "SMESHDS_Group.hxx"
@@ -90,7 +103,11 @@
 
 
 static double HEXA_EPS      = 1.0e-3; //1E-3;
-static double HEXA_QUAD_WAY = M_PI/4.; //3.*PI/8.;
+static int    HEXA_CURVE_SAMPLES = 64; // intervals of arc length tables
+static double HEXA_UV_GAP = 1.e-5; // max distance of a quad node to its face
+static double HEXA_RAY_WINDOW  = 2.; // half search window of _intersect(), in cell sizes
+static double HEXA_RAY_GROWTH  = 4.; // expansion of the window when nothing is found
+static int    HEXA_RAY_RETRIES = 2;  // expansions before the whole line is searched
 
 // ============================================================ string2shape
 TopoDS_Shape string2shape( const std::string& brep )
@@ -117,18 +134,6 @@ bool shape2coord(const TopoDS_Shape& aShape, double& x, double& y, double& z)
        return(0);
    };
 }
-// ============================================================= edge_length
-double edge_length(const TopoDS_Edge & E)
-{
-  double UMin = 0, UMax = 0;
-  if (BRep_Tool::Degenerated(E))
-    return 0;
-  TopLoc_Location L;
-  Handle(Geom_Curve) C = BRep_Tool::Curve(E, L, UMin, UMax);
-  GeomAdaptor_Curve AdaptCurve(C);
-  double length = GCPnts_AbscissaPoint::Length(AdaptCurve, UMin, UMax);
-  return length;
-}
 // =============================================================== make_curve
 BRepAdaptor_Curve* make_curve (gp_Pnt& pstart, gp_Pnt& pend,
                                double& length, double& u_start,
@@ -150,12 +155,11 @@ BRepAdaptor_Curve* make_curve (gp_Pnt& pstart, gp_Pnt& pend,
 // ============================================================== Constructeur
 // SMESH_HexaBlocks::SMESH_HexaBlocks( SMESH_Mesh* theMesh ):
 SMESH_HexaBlocks::SMESH_HexaBlocks(SMESH_Mesh& theMesh):
-  _total(0),
-  _found(0),
-  _notFound(0),
   _computeVertexOK(false),
   _computeEdgeOK(false),
   _computeQuadOK(false),
+  _parallel(true),
+  _rayWindow(HEXA_RAY_WINDOW),
   _theMesh(&theMesh),  //groups creation
   _theMeshDS(theMesh.GetMeshDS()) //meshing
 {
@@ -219,7 +223,28 @@ bool SMESH_HexaBlocks::computeEdgeByAssoc( HEXA_NS::Edge& edge, HEXA_NS::Law& la
 {
   MESSAGE("computeEdgeByAssoc(edgeID = "<<edge.getId()<<"): begin   <<<<<<");
   ASSERT( _computeVertexOK );
-  bool ok = true;
+
+  EdgeDiscretization discr;
+  if ( !_prepareEdgeByAssoc( edge, law, discr ) )
+     return false;
+
+  _computeEdgePoints( discr );
+  bool ok = _commitEdgeByAssoc( discr );
+
+  MESSAGE("computeEdgeByAssoc() : end  >>>>>>>>");
+  return ok;
+}
+
+// ======================================================= _prepareEdgeByAssoc
+// A) Build myCurve and the law parameters of the nodes.
+// Nothing is added to the mesh here.
+bool SMESH_HexaBlocks::_prepareEdgeByAssoc( HEXA_NS::Edge& edge, HEXA_NS::Law& law,
+                                            EdgeDiscretization& discr )
+{
+  discr.edge    = &edge;
+  discr.law     = &law;
+  discr.byAssoc = false;
+  discr.done    = false;
 
   if (NOT edge.isAssociated())
      return false;
@@ -237,92 +262,201 @@ bool SMESH_HexaBlocks::computeEdgeByAssoc( HEXA_NS::Edge& edge, HEXA_NS::Law& la
     vx1 = edge.getVertex(0);
   }
   // nodes on mesh
-  SMDS_MeshNode* FIRST_NODE = _node[vx0];
-  SMDS_MeshNode* LAST_NODE  = _node[vx1];
-
+  discr.firstNode = _node[vx0];
+  discr.lastNode  = _node[vx1];
 
-  // A) Build myCurve_list
-  std::list< BRepAdaptor_Curve* >        myCurve_list;
-  double                                 myCurve_tot_len;
-  std::map< BRepAdaptor_Curve*, double>  myCurve_lengths;
-  std::map< BRepAdaptor_Curve*, bool>    myCurve_ways;
-  std::map< BRepAdaptor_Curve*, double>  myCurve_starts;
-
-  gp_Pnt myCurve_pt_start(FIRST_NODE->X(), FIRST_NODE->Y(), FIRST_NODE->Z());
-  gp_Pnt myCurve_pt_end  (LAST_NODE->X(),  LAST_NODE->Y(),  LAST_NODE->Z());
+  gp_Pnt myCurve_pt_start(discr.firstNode->X(), discr.firstNode->Y(), discr.firstNode->Z());
+  gp_Pnt myCurve_pt_end  (discr.lastNode->X(),  discr.lastNode->Y(),  discr.lastNode->Z());
 
   _buildMyCurve(
       myCurve_pt_start,
       myCurve_pt_end,
-      myCurve_list,
-      myCurve_tot_len,
-      myCurve_lengths,
-      myCurve_ways,
-      myCurve_starts,
+      discr.myCurve,
+      discr.myCurve_tot_len,
       edge
   );
 
+  static const std::vector<double> noNodes;
+  discr.xx = &_Xx( law ); //u between [0,1]
+  if (discr.myCurve.size()==0)
+     {
+     PutData (edge.getName());
+     discr.xx = &noNodes;
+     }
+  MESSAGE("nbNodes -> "<<discr.xx->size());
+
+  discr.byAssoc = true;
+  return true;
+}
+
+// ======================================================== _computeEdgePoints
+// Only reads discr and the CAD: may run concurrently for different edges
+// if privateCurves is set
+void SMESH_HexaBlocks::_computeEdgePoints( EdgeDiscretization& discr,
+                                           bool privateCurves ) const
+{
+  // Evaluation of a curve adaptor updates its internal cache, so a concurrent
+  // computation works on shallow copies of the adaptors of the associations
+  MyCurve myCurve;
+  std::vector< Handle(BRepAdaptor_Curve) > curveCopies;
+  if ( privateCurves ){
+      myCurve = discr.myCurve;
+      curveCopies.resize( myCurve.size() );
+      for (size_t i = 0; i < myCurve.size(); ++i){
+          curveCopies[i] = Handle(BRepAdaptor_Curve)::DownCast( myCurve[i].curve->ShallowCopy() );
+          myCurve[i].curve = curveCopies[i].get();
+      }
+  }
+  const MyCurve& curve = privateCurves ? myCurve : discr.myCurve;
+
+  // B) Compute points on myCurve
+  discr.points.clear();
+  const std::vector<double>& xx = *discr.xx;
+  discr.points.reserve( xx.size() );
+
+  double myCurve_u;
+  CurveCursor cursor;
+  for (size_t i = 0; i < xx.size(); ++i){
+      myCurve_u = xx[i]*discr.myCurve_tot_len;
+
+      MESSAGE("u -> "<<xx[i]);
+      MESSAGE("myCurve_u  -> "<<myCurve_u);
+      MESSAGE("myCurve_tot_len -> "<<discr.myCurve_tot_len);
+
+      discr.points.push_back( _getPtOnMyCurve( myCurve_u, curve, cursor ));
+  }
+  discr.done = true;
+}
+
+// ======================================================== _commitEdgeByAssoc
+// C) Build nodes and edges on mesh from the computed points
+bool SMESH_HexaBlocks::_commitEdgeByAssoc( EdgeDiscretization& discr )
+{
+  HEXA_NS::Edge& edge = *discr.edge;
+  if ( NOT discr.done )
+     _computeEdgePoints( discr ); // raise the error as in serial mode
 
-  // B) Build nodes and edges on mesh from myCurve_list
   SMDS_MeshNode* node_a  = NULL;
   SMDS_MeshNode* node_b  = NULL;
   SMDS_MeshEdge* edge_ab = NULL;
   SMESHNodes     nodesOnEdge;
   SMESHEdges     edgesOnEdge; //backup for group creation
-//   Xx             nodesXxOnEdge;
-
-  node_a = FIRST_NODE;
-  nodesOnEdge.push_back(FIRST_NODE);
-//   nodesXxOnEdge.push_back(0.);
-  // _nodeXx[FIRST_NODE] = 0.;
-
-  gp_Pnt ptOnMyCurve;
-  double u, myCurve_u;
-  double myCurve_start_u = 0.;
-  int nbNodes = law.getNodes(); //law of discretization
-  if (myCurve_list.size()==0)
-     {
-     PutData (edge.getName());
-     nbNodes = 0;
-     }
-  MESSAGE("nbNodes -> "<<nbNodes);
-  for (int i = 0; i < nbNodes; ++i){
-      u = _Xx(i, law, nbNodes); //u between [0,1]
-      myCurve_u = u*myCurve_tot_len;
-
-      MESSAGE("u -> "<<u);
-      MESSAGE("myCurve_u  -> "<<myCurve_u);
-      MESSAGE("myCurve_tot_len -> "<<myCurve_tot_len);
+  nodesOnEdge.reserve( discr.points.size() + 2 );
+  edgesOnEdge.reserve( discr.points.size() + 1 );
 
-      ptOnMyCurve = _getPtOnMyCurve( myCurve_u,
-                                     myCurve_ways,
-                                     myCurve_lengths,
-                                     myCurve_starts,
-                                     myCurve_list,
-                                     myCurve_start_u
-                                     );
+  node_a = discr.firstNode;
+  nodesOnEdge.push_back(discr.firstNode);
 
+  for (size_t i = 0; i < discr.points.size(); ++i){
+      const gp_Pnt& ptOnMyCurve = discr.points[i];
       node_b = _theMeshDS->AddNode( ptOnMyCurve.X(), ptOnMyCurve.Y(), ptOnMyCurve.Z() );
       edge_ab     = _theMeshDS->AddEdge( node_a, node_b );
       nodesOnEdge.push_back( node_b );
       edgesOnEdge.push_back( edge_ab );
       if  (_nodeXx.count(node_b) >= 1 ) ASSERT(false);
-      _nodeXx[node_b] = u;
+      _nodeXx[node_b] = (*discr.xx)[i];
       node_a = node_b;
   }
-  edge_ab      = _theMeshDS->AddEdge( node_a, LAST_NODE );
-  nodesOnEdge.push_back( LAST_NODE );
+  edge_ab      = _theMeshDS->AddEdge( node_a, discr.lastNode );
+  nodesOnEdge.push_back( discr.lastNode );
   edgesOnEdge.push_back( edge_ab );
-  _nodesOnEdge[&edge] = nodesOnEdge;
-  _edgesOnEdge[&edge] = edgesOnEdge;
+  _nodesOnEdge[&edge].swap( nodesOnEdge );
+  _edgesOnEdge[&edge].swap( edgesOnEdge );
 
-
-  MESSAGE("computeEdgeByAssoc() : end  >>>>>>>>");
-  return ok;
+  return true;
 }
 
+// ========================================================= EdgePointsFunctor
+struct SMESH_HexaBlocks::EdgePointsFunctor
+{
+  const SMESH_HexaBlocks*                           _builder;
+  std::vector< SMESH_HexaBlocks::EdgeDiscretization >& _discr;
+
+  EdgePointsFunctor( const SMESH_HexaBlocks* builder,
+                     std::vector< SMESH_HexaBlocks::EdgeDiscretization >& discr ):
+    _builder( builder ), _discr( discr ) {}
+
+  void operator()( const int i ) const
+  {
+    if ( NOT _discr[i].byAssoc )
+       return;
+    try {
+      _builder->_computeEdgePoints( _discr[i], /*privateCurves=*/true );
+    } catch(...) {
+      _discr[i].done = false; // recomputed at commit
+    }
+  }
+};
+
+// ============================================================= computeEdges
+bool SMESH_HexaBlocks::computeEdges( HEXA_NS::Document* doc )
+{
+  MESSAGE("computeEdges() : : begin   <<<<<<");
+  bool ok = true;
+  int nbPropa = 0;
+  HEXA_NS::Propagation* propa = NULL;
+  HEXA_NS::Law*         law   = NULL;
+  HEXA_NS::Edges edges;
+
+  // edges in the order of the serial computation
+  std::vector< std::pair<HEXA_NS::Edge*, HEXA_NS::Law*> > edgeLaws;
+  nbPropa = doc->countPropagation();
+  for (int j=0; j < nbPropa; ++j ){//Computing each edge's propagations of the document
+    propa = doc->getPropagation(j);
+    edges = propa->getEdges();
+    law   = propa->getLaw();
+//     ASSERT( law );
+    if (law == NULL){
+      law = doc->getLaw(0); // default law
+    }
+    _Xx( *law ); // coefficient checked before any edge is meshed
+    for( HEXA_NS::Edges::const_iterator iter = edges.begin();
+        iter != edges.end();
+        ++iter ){
+        edgeLaws.push_back( std::make_pair( *iter, law ));
+    }
+  }
+
+  if ( NOT _parallel ){
+    for ( size_t i = 0; i < edgeLaws.size(); ++i )
+      ok = computeEdge( *edgeLaws[i].first, *edgeLaws[i].second );
+    MESSAGE("computeEdges() : end  >>>>>>>>");
+    return ok;
+  }
 
+  // 1) serial: curves and law parameters. If a preparation fails, the edges
+  //    before it are meshed first and the error is raised by meshing the
+  //    failed edge, leaving the same partial mesh as in serial mode
+  std::vector< EdgeDiscretization > discr( edgeLaws.size() );
+  size_t nbPrepared = 0;
+  try {
+    for ( ; nbPrepared < edgeLaws.size(); ++nbPrepared )
+      _prepareEdgeByAssoc( *edgeLaws[nbPrepared].first, *edgeLaws[nbPrepared].second,
+                           discr[nbPrepared] );
+  } catch(...) {
+    discr.resize( nbPrepared );
+  }
 
+  // 2) parallel: points on the CAD curves
+  OSD_Parallel::For( 0, (int) discr.size(), EdgePointsFunctor( this, discr ));
+
+  // 3) serial: nodes and edges, in the same order as in serial mode
+  for ( size_t i = 0; i < discr.size(); ++i ){
+    if ( discr[i].byAssoc ){
+      ok = _commitEdgeByAssoc( discr[i] );
+      _computeEdgeOK = true;
+    } else {
+      ok = computeEdge( *discr[i].edge, *discr[i].law );
+    }
+  }
+  for ( size_t i = nbPrepared; i < edgeLaws.size(); ++i )
+    ok = computeEdge( *edgeLaws[i].first, *edgeLaws[i].second );
+
+  MESSAGE("computeEdges() : curve cache hits = "<<_curveCache.nbHits()
+          <<", misses = "<<_curveCache.nbMisses());
+  MESSAGE("computeEdges() : end  >>>>>>>>");
+  return ok;
+}
 
 bool SMESH_HexaBlocks::computeEdgeByShortestWire( HEXA_NS::Edge& edge, HEXA_NS::Law& law)
 {
@@ -380,10 +514,13 @@ bool SMESH_HexaBlocks::computeEdgeBySegment(HEXA_NS::Edge& edge, HEXA_NS::Law& l
   nodesOnEdge.push_back(FIRST_NODE);
 
   //law of discretization
-  int nbNodes = law.getNodes();
+  const std::vector<double>& xx = _Xx( law );
+  int nbNodes = xx.size();
   MESSAGE("nbNodes -> "<<nbNodes);
+  nodesOnEdge.reserve( nbNodes + 2 );
+  edgesOnEdge.reserve( nbNodes + 1 );
   for (int i = 0; i < nbNodes; ++i){
-    u = _Xx(i, law, nbNodes);
+    u = xx[i];
     newNodeX = FIRST_NODE->X() + u * ( LAST_NODE->X() - FIRST_NODE->X() );
     newNodeY = FIRST_NODE->Y() + u * ( LAST_NODE->Y() - FIRST_NODE->Y() );
     newNodeZ = FIRST_NODE->Z() + u * ( LAST_NODE->Z() - FIRST_NODE->Z() );
@@ -400,8 +537,8 @@ bool SMESH_HexaBlocks::computeEdgeBySegment(HEXA_NS::Edge& edge, HEXA_NS::Law& l
   nodesOnEdge.push_back(LAST_NODE);
   edgesOnEdge.push_back(newEdge);
 
-  _nodesOnEdge[&edge] = nodesOnEdge;
-  _edgesOnEdge[&edge] = edgesOnEdge;
+  _nodesOnEdge[&edge].swap( nodesOnEdge );
+  _edgesOnEdge[&edge].swap( edgesOnEdge );
 
   MESSAGE("computeEdgeBySegment() : end  >>>>>>>>");
   return ok;
@@ -411,16 +548,18 @@ bool SMESH_HexaBlocks::computeEdgeBySegment(HEXA_NS::Edge& edge, HEXA_NS::Law& l
 // --------------------------------------------------------------
 //                        Quad computing
 // --------------------------------------------------------------
+// Breadth first walk on the skin quads, from a quad whose way is known
+// ( see _scoreQuadWays ), one connected skin after the other. The
+// adjacency of the skin quads and the ways of their edges are indexed once.
 std::map<HEXA_NS::Quad*, bool>  SMESH_HexaBlocks::computeQuadWays( HEXA_NS::Document* doc )
 {
+  typedef std::pair<HEXA_NS::Vertex*, HEXA_NS::Vertex*> EdgeWay; // first, last vertex
   std::map<HEXA_NS::Quad*, bool>  quadWays;
-  std::map<HEXA_NS::Edge*, std::pair<HEXA_NS::Vertex*, HEXA_NS::Vertex*> > edgeWays;
-  std::list<HEXA_NS::Quad*>       skinQuad;
-  std::list<HEXA_NS::Quad*>       workingQuad;
-  HEXA_NS::Quad* first_q = NULL;
+  std::vector<HEXA_NS::Quad*>     skinQuads;
+  std::map<HEXA_NS::Quad*, int>   skinIndex;
   HEXA_NS::Quad* q = NULL;
   HEXA_NS::Edge* e = NULL;
-  HEXA_NS::Vertex *e_0, *e_1 = NULL;
+  HEXA_NS::Vertex *e_0 = NULL, *e_1 = NULL;
 
   // FIRST STEP: eliminate free quad + internal quad
   int nTotalQuad = doc->countUsedQuad();
@@ -428,53 +567,124 @@ std::map<HEXA_NS::Quad*, bool>  SMESH_HexaBlocks::computeQuadWays( HEXA_NS::Docu
     q = doc->getUsedQuad(i);
     switch ( q->getNbrParents() ){ // parent == hexaedron
       case 0: case 2: quadWays[q] = true; break;
-      case 1: skinQuad.push_back(q); break;
+      case 1:
+        skinIndex[q] = skinQuads.size();
+        skinQuads.push_back(q);
+        break;
       default: if ( q->getNbrParents() > 2 ) ASSERT(false);
     }
   }
 
+  // edges of the skin quads and skin quads adjacent by an edge, in the
+  // order of the edges and of their parents
+  int nSkin = skinQuads.size();
+  std::map<HEXA_NS::Edge*, int> edgeIndex;
+  std::vector<int> quadEdges( 4*nSkin );
+  std::vector<int> adjStart( nSkin+1, 0 ), adjacent;
+  for ( int k = 0; k < nSkin; ++k ){
+    q = skinQuads[k];
+    for ( int i = 0; i < 4; ++i ){
+      e = q->getEdge(i);
+      quadEdges[ 4*k+i ] =
+        edgeIndex.insert( std::make_pair( e, (int) edgeIndex.size() )).first->second;
+      for ( int j = 0; j < e->getNbrParents(); ++j ){
+        HEXA_NS::Quad* next_q = e->getParent(j);
+        if ( next_q == q ) continue;
+        std::map<HEXA_NS::Quad*, int>::const_iterator n = skinIndex.find( next_q );
+        if ( n != skinIndex.end() )
+          adjacent.push_back( n->second );
+      }
+    }
+    adjStart[ k+1 ] = adjacent.size();
+  }
+
+  // connected skins, in the order of their first quad, and their best
+  // conditioned initial quad
+  std::vector<int> component( nSkin, -1 );
+  int nbComponents = 0;
+  std::deque<int> workingQuads;
+  for ( int k = 0; k < nSkin; ++k ){
+    if ( component[k] >= 0 ) continue;
+    component[k] = nbComponents;
+    workingQuads.push_back( k );
+    while ( NOT workingQuads.empty() ){
+      int c = workingQuads.front();
+      workingQuads.pop_front();
+      for ( int a = adjStart[c]; a < adjStart[c+1]; ++a )
+        if ( component[ adjacent[a] ] < 0 ){
+          component[ adjacent[a] ] = nbComponents;
+          workingQuads.push_back( adjacent[a] );
+        }
+    }
+    ++nbComponents;
+  }
+  std::vector<double> scores;
+  std::vector<char>   forward;
+  _scoreQuadWays( skinQuads, scores, forward );
+  std::vector<int> seeds( nbComponents, -1 );
+  for ( int k = 0; k < nSkin; ++k ){
+    int& seed = seeds[ component[k] ];
+    if ( scores[k] > 0. && ( seed < 0 || scores[k] > scores[seed] ))
+      seed = k;
+  }
+
   // SECOND STEP: setting edges ways
-  while ( skinQuad.size()>0 ){
+  std::vector<EdgeWay> edgeWays( edgeIndex.size(), EdgeWay( NULL, NULL ));
+  std::vector<char>    done( nSkin, 0 ), queued( nSkin, 0 );
+  for ( int iComp = 0; iComp < nbComponents; ++iComp ){
     MESSAGE("SEARCHING INITIAL QUAD ..." );
-    for ( std::list<HEXA_NS::Quad*>::iterator it = skinQuad.begin(); it != skinQuad.end(); it++ ){
-        _searchInitialQuadWay( *it, e_0, e_1 );
-        if ( e_0 != NULL && e_1 != NULL ){
-          q = first_q = *it;
-          break;
-        }
+    int first = seeds[ iComp ];
+    if ( first < 0 ){
+      MESSAGE("NO INITIAL QUAD FOUND FOR SKIN "<< iComp );
+      ASSERT(false);// should never happened,
+      continue;
+    }
+    if ( forward[ first ] ){
+      e_0 = skinQuads[ first ]->getVertex(0); e_1 = skinQuads[ first ]->getVertex(1);
+    } else {
+      e_0 = skinQuads[ first ]->getVertex(1); e_1 = skinQuads[ first ]->getVertex(0);
     }
-    if ( e_0 == NULL && e_1 == NULL ) ASSERT(false);// should never happened,
     MESSAGE("INITIAL QUAD FOUND!" );
+    HEXA_NS::Quad* first_q = skinQuads[ first ];
     for ( int j=0 ; j < 4 ; ++j ){
-      e = q->getEdge(j);
+      e = first_q->getEdge(j);
       if  (    ((e_0 == e->getVertex(0)) && (e_1 == e->getVertex(1)))
             || ((e_0 == e->getVertex(1)) && (e_1 == e->getVertex(0))) ){
+        edgeWays[ quadEdges[ 4*first+j ]] = EdgeWay( e_0, e_1 );
         break;
       }
     }
     MESSAGE("INITIAL EDGE WAY FOUND!" );
 
-    edgeWays[e] = std::make_pair( e_0, e_1 );
-    workingQuad.push_back(q);
+    workingQuads.push_back( first );
+    queued[ first ] = 1;
 
-    while ( workingQuad.size() > 0 ){
+    while ( NOT workingQuads.empty() ){
+        int k = workingQuads.front();
+        workingQuads.pop_front();
+        q = skinQuads[k];
         MESSAGE("COMPUTE QUAD WAY ... ID ="<< q->getId());
+
+        // ways of the edges in the quad, from an edge whose way is known
         HEXA_NS::Vertex *lastVertex=NULL, *firstVertex = NULL;
-        int i = 0;
-        std::map<HEXA_NS::Edge*, std::pair<HEXA_NS::Vertex*, HEXA_NS::Vertex*> > localEdgeWays;
-        while ( localEdgeWays.size() != 4 ){
-            HEXA_NS::Edge* e = q->getEdge(i%4);
+        EdgeWay localEdgeWays[4];
+        int nbLocal = 0;
+        for ( int i = 0; nbLocal != 4 && i < 8; ++i ){
+            int ie = i%4;
+            EdgeWay& edgeWay = edgeWays[ quadEdges[ 4*k+ie ]];
             if ( lastVertex == NULL ){
-                if ( edgeWays.count(e) == 1 ){
+                if ( edgeWay.first != NULL ){
                   if ( q == first_q ){
-                    localEdgeWays[e] = std::make_pair( edgeWays[e].first, edgeWays[e].second );
+                    localEdgeWays[ie] = edgeWay;
                   } else {
-                    localEdgeWays[e] = std::make_pair( edgeWays[e].second, edgeWays[e].first);
+                    localEdgeWays[ie] = EdgeWay( edgeWay.second, edgeWay.first );
                   }
-                  firstVertex = localEdgeWays[e].first;
-                  lastVertex  = localEdgeWays[e].second;
+                  firstVertex = localEdgeWays[ie].first;
+                  lastVertex  = localEdgeWays[ie].second;
+                  ++nbLocal;
                 }
             } else {
+              e = q->getEdge(ie);
               HEXA_NS::Vertex* e_0 = e->getVertex(0);
               HEXA_NS::Vertex* e_1 = e->getVertex(1);
 
@@ -489,58 +699,39 @@ std::map<HEXA_NS::Quad*, bool>  SMESH_HexaBlocks::computeQuadWays( HEXA_NS::Docu
               } else {
                 ASSERT(false);
               }
-              localEdgeWays[e] = std::make_pair( firstVertex, lastVertex );
-              if ( edgeWays.count(e) == 0 ){ // keep current value if present otherwise add it
-                edgeWays[e] = localEdgeWays[e];
+              localEdgeWays[ie] = EdgeWay( firstVertex, lastVertex );
+              if ( edgeWay.first == NULL ){ // keep current value if present otherwise add it
+                edgeWay = localEdgeWays[ie];
               }
+              ++nbLocal;
             }
-            ++i;
         }
 
-
         //add new working quad
-        for ( int i=0 ; i < 4; ++i ){
-            HEXA_NS::Quad* next_q = NULL;
-            HEXA_NS::Edge* e = q->getEdge(i);
-            for ( int j=0 ; j < e->getNbrParents(); ++j ){
-                next_q = e->getParent(j);
-                if ( next_q == q ){
-                  next_q = NULL;
-                }
-                int fromSkin = std::count( skinQuad.begin(), skinQuad.end(), next_q );
-                if (fromSkin != 0){
-                  int fromWorkingQuad = std::count( workingQuad.begin(), workingQuad.end(), next_q );
-                    if ( fromWorkingQuad == 0 ){
-                        workingQuad.push_front( next_q );
-                    }
-                }
+        for ( int a = adjStart[k]; a < adjStart[k+1]; ++a ){
+            int next = adjacent[a];
+            if ( NOT done[ next ] && NOT queued[ next ] ){
+              workingQuads.push_back( next );
+              queued[ next ] = 1;
             }
         }
 
         // setting quad way
-        HEXA_NS::Edge* e0 = q->getEdge(0);
-        HEXA_NS::Vertex* e0_0 = e0->getVertex(0);
+        HEXA_NS::Vertex* e0_0 = q->getEdge(0)->getVertex(0);
 
-        if (  e0_0 == localEdgeWays[ e0 ].first ){
+        if (  e0_0 == localEdgeWays[0].first ){
             quadWays[q] = true;
-        } else if ( e0_0 == localEdgeWays[ e0 ].second ){
+        } else if ( e0_0 == localEdgeWays[0].second ){
             quadWays[q] = false;
         } else {
           ASSERT(false);
         }
-        workingQuad.remove( q );
-        skinQuad.remove( q );
-        q = workingQuad.back();
+        done[k] = 1;
     }
   }
 
   return quadWays;
 }
-
-
-
-
-
 // std::map<HEXA_NS::Quad*, bool>  SMESH_HexaBlocks::computeQuadWays( HEXA_NS::Document& doc, std::map<HEXA_NS::Quad*, bool>  initQuads )
 // {
 //   std::map<HEXA_NS::Quad*, bool>  quadWays;
@@ -695,94 +886,214 @@ bool SMESH_HexaBlocks::computeQuad( HEXA_NS::Quad& quad, bool way )
 
 bool SMESH_HexaBlocks::computeQuadByAssoc( HEXA_NS::Quad& quad, bool way  )
 {
-//   int id = quad.getId();
-//   if ( id != 11 )  return false; //7
-
-  MESSAGE("computeQuadByLinearApproximation() : : begin   <<<<<<");
+  MESSAGE("computeQuadByAssoc() : : begin   <<<<<<");
   MESSAGE("quadID = "<<quad.getId());
 
   ASSERT( _computeEdgeOK );
-  bool ok = true;
+  QuadDiscretization discr;
+  if ( NOT _prepareQuad( quad, way, true, discr )){
+    MESSAGE("computeQuadByAssoc() : end  >>>>>>>>");
+    return false;
+  }
+  _computeQuadPoints( discr, _intersectors );
+  bool ok = _commitQuad( discr );
+
+  MESSAGE("computeQuadByAssoc() : end  >>>>>>>>");
+  return ok;
+}
 
-  ArrayOfSMESHNodes nodesOnQuad; // nodes in this quad ( to be added on the mesh )
-  SMESHFaces      facesOnQuad;
-  SMDS_MeshFace*  newFace = NULL;
-  std::vector<double> xx, yy;
+// ================================================================ QuadGrid
+void SMESH_HexaBlocks::QuadGrid::resize( int iSize, int jSize )
+{
+  Cell empty;
+  empty.node = NULL;
+  _iSize = iSize;
+  _jSize = jSize;
+  _cells.assign( iSize*jSize, empty );
+}
 
-  // Elements for quad computation
-  SMDS_MeshNode *S1, *S2, *S4, *S3;
+void SMESH_HexaBlocks::QuadGrid::swap( QuadGrid& other )
+{
+  std::swap( _iSize, other._iSize );
+  std::swap( _jSize, other._jSize );
+  _cells.swap( other._cells );
+}
 
-//   bool initOk = _computeQuadInit( quad, eh, eb, eg, ed, S1, S2, S3, S4 );
-  bool initOk = _computeQuadInit( quad, nodesOnQuad, xx, yy );
+// ============================================================ _prepareQuad
+// Boundary nodes and law parameters. Reads the data of the edges: serial
+bool SMESH_HexaBlocks::_prepareQuad( HEXA_NS::Quad& quad, bool way, bool byAssoc,
+                                     QuadDiscretization& discr )
+{
+  discr.quad    = &quad;
+  discr.way     = way;
+  discr.byAssoc = byAssoc;
+  discr.done    = false;
+  discr.nodesOnQuad.clear();
+  discr.xx.clear();
+  discr.yy.clear();
+  discr.face = TopoDS_Face();
+  discr.uvOnQuad.clear();
+  discr.assoShapes.clear();
+  discr.assoShape = TopoDS_Shape();
+  discr.assoKey.clear();
+
+  bool initOk = _computeQuadInit( quad, discr.nodesOnQuad, discr.xx, discr.yy );
   if ( initOk == false ){
     return false;
   }
-
-  int nbass  = quad.countAssociation ();
-  if (nbass==0)
-  {
-     MESSAGE("computeQuadByAssoc() : end  >>>>>>>>");
-     return false;
+  if ( byAssoc && quad.countAssociation() == 0 ){
+    return false;
   }
+  if ( byAssoc ){
+    // the shapes of the associations may be updated on access: done here,
+    // before the quads are computed by concurrent threads
+    for ( int nro = 0; nro < quad.countAssociation(); ++nro )
+      discr.assoShapes.push_back( quad.getAssociation( nro )->getShape() );
+    discr.assoKey = _faceShapesKey( quad );
+    if ( discr.assoShapes.size() == 1 )
+      discr.assoShape = discr.assoShapes[0];
+    else
+      discr.assoShape = _faceCompounds.add( quad );
+  }
+  return true;
+}
 
-  TopoDS_Shape shapeOrCompound = getFaceShapes ( quad );
+// ====================================================== _computeQuadPoints
+// Only reads discr and the CAD: may run concurrently for different quads,
+// with different intersectors
+void SMESH_HexaBlocks::_computeQuadPoints( QuadDiscretization& discr,
+                                          IntersectorCache& intersectors ) const
+{
+  QuadGrid&                  nodesOnQuad = discr.nodesOnQuad;
+  const std::vector<double>& xx = discr.xx;
+  const std::vector<double>& yy = discr.yy;
+  int iSize = nodesOnQuad.iSize();
+  int jSize = nodesOnQuad.jSize();
+
+  discr.points.assign( iSize*jSize, gp_Pnt() );
+  discr.stats = ProjectionStats();
+
+  // a quad on a single face is interpolated in the parameter space of the
+  // face, the others in 3D and projected along the normal of the quad
+  TopoDS_Face           face = discr.face; // found by computeQuadByFindingGeom
+  std::vector<gp_Pnt2d> uvOnAssoc;
+  Handle(Geom_Surface)  surface;
+  IntCurvesFace_ShapeIntersector* inter = NULL;
+  QuadSurfaces          surfaces;
+  bool byUV = NOT face.IsNull();
+  if ( discr.byAssoc ){
+    TopoDS_Shape shape;
+    if ( discr.assoShapes.size() == 1 )
+      shape = discr.assoShape;
+    byUV = ( NOT shape.IsNull() && shape.ShapeType() == TopAbs_FACE &&
+             _projectQuadBoundary( TopoDS::Face( shape ), nodesOnQuad, uvOnAssoc ));
+    if ( byUV ){
+      face = TopoDS::Face( shape );
+    } else {
+      inter = &intersectors.get( discr.assoKey, discr.assoShape );
+      surfaces.load( discr.assoShapes );
+    }
+  }
+  if ( byUV )
+    surface = BRep_Tool::Surface( face );
+  const std::vector<gp_Pnt2d>& uvOnQuad = discr.byAssoc ? uvOnAssoc : discr.uvOnQuad;
+
+  // interpolated points of the inner nodes, in the parameter space of the
+  // face or in 3D: the grid holds them, before projection
+  int nbCoords = byUV ? 2 : 3;
+  std::vector<double> boundary( 2*(iSize+jSize) ), inner( iSize*jSize );
+  std::vector<double> uvInner( byUV ? 2*iSize*jSize : 0 );
+  double* b = &boundary[0];
+  double* h = b + iSize;
+  double* g = h + iSize;
+  double* d = g + jSize;
+  for ( int c = 1; c <= nbCoords; ++c ){
+    for (int i = 0; i < iSize; ++i){
+      b[i] = byUV ? uvOnQuad[ i*jSize ].Coord(c)         : nodesOnQuad.point(i, 0).Coord(c);
+      h[i] = byUV ? uvOnQuad[ i*jSize + jSize-1 ].Coord(c) : nodesOnQuad.point(i, jSize-1).Coord(c);
+    }
+    for (int j = 0; j < jSize; ++j){
+      g[j] = byUV ? uvOnQuad[ j ].Coord(c)                 : nodesOnQuad.point(0, j).Coord(c);
+      d[j] = byUV ? uvOnQuad[ (iSize-1)*jSize + j ].Coord(c) : nodesOnQuad.point(iSize-1, j).Coord(c);
+    }
+    _coonsPatch( iSize, jSize, &xx[0], &yy[0], b, h, g, d, &inner[0] );
+    for (int i = 1; i < iSize-1; ++i)
+      for (int j = 1; j < jSize-1; ++j)
+        if ( byUV )
+          uvInner[ 2*(i*jSize + j) + c-1 ] = inner[ i*jSize + j ];
+        else
+          nodesOnQuad.point(i, j).SetCoord( c, inner[ i*jSize + j ] );
+  }
 
+  std::vector<SurfacePoint> surfacePoints( iSize*jSize ); // known on interior nodes only
+  for (int j = 1; j < jSize; ++j){
+    for (int i = 1; i < iSize; ++i){
+        if ( nodesOnQuad.node(i, j) != NULL )
+          continue;
+        gp_Pnt& ptOnShape = discr.points[ i*jSize + j ];
+
+        if ( byUV ){
+            double uS = uvInner[ 2*(i*jSize + j) ];
+            double vS = uvInner[ 2*(i*jSize + j) + 1 ];
+            ptOnShape = surface->Value( uS, vS );
+
+            MESSAGE("point on face ("<<uS<<","<<vS<<") -> ("
+                    <<ptOnShape.X()<<","<<ptOnShape.Y()<<","<<ptOnShape.Z()<<" )");
+            continue;
+        }
 
-  std::map<SMDS_MeshNode*, gp_Pnt> interpolatedPoints;
-  int iSize = nodesOnQuad.size();
-  int jSize = nodesOnQuad[0].size();
+        const gp_Pnt& newPt = nodesOnQuad.point(i, j); //interpolated point
+        if ( NOT discr.byAssoc ){
+            ptOnShape = newPt;
+            continue;
+        }
+        const gp_Pnt& pt1 = nodesOnQuad.point(i-1, j);
+        const gp_Pnt& pt3 = nodesOnQuad.point(i, j-1);
+        gp_Vec vec1( newPt, pt1 );
+        gp_Vec vec2( newPt, pt3 );
+
+        // the left neighbour is seed, else the one below
+        const SurfacePoint& seed = ( surfacePoints[ (i-1)*jSize + j ].face >= 0 ) ?
+          surfacePoints[ (i-1)*jSize + j ] : surfacePoints[ i*jSize + j-1 ];
+        ptOnShape = _projectOnQuad(newPt, vec1, vec2, surfaces, *inter,
+                                   seed, surfacePoints[ i*jSize + j ], discr.stats);
+
+        MESSAGE("u parameter is "<<xx[i]);
+        MESSAGE("v parameter is "<<yy[j]);
+        MESSAGE("point interpolated ("<<newPt.X()<<","<<newPt.Y()<<","<<newPt.Z()<<" )");
+        MESSAGE("point on shape     ("<<ptOnShape.X()<<","<<ptOnShape.Y()<<","<<ptOnShape.Z()<<" )");
+    }
+  }
+  discr.done = true;
+}
 
-  S1 = nodesOnQuad[0][0];
-  S2 = nodesOnQuad[iSize-1][0];
-  S4 = nodesOnQuad[0][jSize-1];
-  S3 = nodesOnQuad[iSize-1][jSize-1];
+// ============================================================= _commitQuad
+// Nodes and faces are added in the same order as they are computed
+bool SMESH_HexaBlocks::_commitQuad( QuadDiscretization& discr )
+{
+  if ( NOT discr.done ) // failed in parallel
+    _computeQuadPoints( discr, _intersectors );
+  _projections.add( discr.stats );
 
+  QuadGrid&          nodesOnQuad = discr.nodesOnQuad;
+  SMESHFaces         facesOnQuad;
+  SMDS_MeshFace*     newFace = NULL;
+  int iSize = nodesOnQuad.iSize();
+  int jSize = nodesOnQuad.jSize();
+  facesOnQuad.reserve( (iSize-1)*(jSize-1) );
 
   for (int j = 1; j < jSize; ++j){
     for (int i = 1; i < iSize; ++i){
-        SMDS_MeshNode* n1 = nodesOnQuad[i-1][j];
-        SMDS_MeshNode* n2 = nodesOnQuad[i-1][j-1];
-        SMDS_MeshNode* n3 = nodesOnQuad[i][j-1];
-        SMDS_MeshNode* n4 = nodesOnQuad[i][j];
+        SMDS_MeshNode* n1 = nodesOnQuad.node(i-1, j);
+        SMDS_MeshNode* n2 = nodesOnQuad.node(i-1, j-1);
+        SMDS_MeshNode* n3 = nodesOnQuad.node(i, j-1);
+        SMDS_MeshNode* n4 = nodesOnQuad.node(i, j);
 
         if ( n4 == NULL ){
-            double newNodeX, newNodeY, newNodeZ;
-            SMDS_MeshNode* Ph = nodesOnQuad[i][jSize-1];   //dNodes[h_i];
-            SMDS_MeshNode* Pb = nodesOnQuad[i][0];   //bNodes[b_i];
-            SMDS_MeshNode* Pg = nodesOnQuad[0][j];   //gNodes[g_j];
-            SMDS_MeshNode* Pd = nodesOnQuad[iSize-1][j];  //dNodes[d_j];
-            double u = xx[i];
-            double v = yy[j];
-
-            _nodeInterpolationUV(u, v, Pg, Pd, Ph, Pb, S1, S2, S3, S4, newNodeX, newNodeY, newNodeZ);
-              gp_Pnt newPt = gp_Pnt( newNodeX, newNodeY, newNodeZ );//interpolated point
-              gp_Pnt pt1;
-              gp_Pnt pt3;
-              if ( interpolatedPoints.count(n1) > 0 ){
-                      pt1 = interpolatedPoints[n1];
-              } else {
-                      pt1 = gp_Pnt( n1->X(), n1->Y(), n1->Z() );
-              }
-              if ( interpolatedPoints.count(n3) > 0 ){
-                      pt3 = interpolatedPoints[n3];
-              } else {
-                      pt3 = gp_Pnt( n3->X(), n3->Y(), n3->Z() );
-              }
-              gp_Vec vec1( newPt, pt1 );
-              gp_Vec vec2( newPt, pt3 );
-
-              gp_Pnt ptOnShape = _intersect(newPt, vec1, vec2, shapeOrCompound);
-              newNodeX = ptOnShape.X();
-              newNodeY = ptOnShape.Y();
-              newNodeZ = ptOnShape.Z();
-              n4 = _theMeshDS->AddNode( newNodeX, newNodeY, newNodeZ );
-              nodesOnQuad[i][j] = n4;
-              interpolatedPoints[ n4 ] = newPt;
-
-              MESSAGE("u parameter is "<<u);
-              MESSAGE("v parameter is "<<v);
-              MESSAGE("point interpolated ("<<newPt.X()<<","<<newPt.Y()<<","<<newPt.Z()<<" )");
-              MESSAGE("point on shape     ("<<newNodeX<<","<<newNodeY<<","<<newNodeZ<<" )");
+            const gp_Pnt& pt = discr.points[ i*jSize + j ];
+            n4 = _theMeshDS->AddNode( pt.X(), pt.Y(), pt.Z() );
+            nodesOnQuad.node(i, j)  = n4;
+            nodesOnQuad.point(i, j) = pt;
         }
 
         MESSAGE("n1 (" << n1->X() << "," << n1->Y() << "," << n1->Z() << ")");
@@ -790,7 +1101,7 @@ bool SMESH_HexaBlocks::computeQuadByAssoc( HEXA_NS::Quad& quad, bool way  )
         MESSAGE("n4 (" << n4->X() << "," << n4->Y() << "," << n4->Z() << ")");
         MESSAGE("n3 (" << n3->X() << "," << n3->Y() << "," << n3->Z() << ")");
 
-        if ( way == true ){
+        if ( discr.way == true ){
             MESSAGE("AddFace( n1, n2, n3, n4 )");
             newFace = _theMeshDS->AddFace( n1, n2, n3, n4 );
         } else {
@@ -800,23 +1111,308 @@ bool SMESH_HexaBlocks::computeQuadByAssoc( HEXA_NS::Quad& quad, bool way  )
         facesOnQuad.push_back(newFace);
       }
   }
-  _quadNodes[ &quad ] = nodesOnQuad;
-  _facesOnQuad[&quad] = facesOnQuad;
+  _quadNodes[ discr.quad ].swap( nodesOnQuad );
+  _facesOnQuad[ discr.quad ].swap( facesOnQuad );
+  return true;
+}
 
-  MESSAGE("computeQuadByLinearApproximation() : end  >>>>>>>>");
+// ======================================================= QuadPointsFunctor
+// A task computes one quad. Each thread has its own intersectors, kept for
+// the next quads it computes
+struct SMESH_HexaBlocks::QuadPointsFunctor
+{
+  const SMESH_HexaBlocks*                              _builder;
+  std::vector< SMESH_HexaBlocks::QuadDiscretization >& _discr;
+  const std::vector<int>&                              _tasks; // quads to compute
+  std::vector< SMESH_HexaBlocks::IntersectorCache >&   _intersectors; // by thread
+
+  QuadPointsFunctor( const SMESH_HexaBlocks* builder,
+                     std::vector< SMESH_HexaBlocks::QuadDiscretization >& discr,
+                     const std::vector<int>& tasks,
+                     std::vector< SMESH_HexaBlocks::IntersectorCache >& intersectors ):
+    _builder( builder ), _discr( discr ), _tasks( tasks ), _intersectors( intersectors ) {}
+
+  void operator()( const int thread, const int t ) const
+  {
+    SMESH_HexaBlocks::QuadDiscretization& discr = _discr[ _tasks[t] ];
+    try {
+      _builder->_computeQuadPoints( discr, _intersectors[ thread ] );
+    } catch(...) {
+      discr.done = false; // recomputed at commit
+    }
+  }
+};
+
+// ============================================================ computeQuads
+bool SMESH_HexaBlocks::computeQuads( HEXA_NS::Document* doc )
+{
+  MESSAGE("computeQuads() : : begin   <<<<<<");
+  bool ok = true;
+
+  std::map<HEXA_NS::Quad*, bool>  quadWays = computeQuadWays(doc);
+  std::vector< std::pair<HEXA_NS::Quad*, bool> > quads;
+  int nQuad = doc->countUsedQuad();
+  HEXA_NS::Quad* q = NULL;
+  for (int j=0; j <nQuad; ++j ){ //Computing each quad of the document
+    q = doc->getUsedQuad(j);
+    int id = q->getId();
+    if ( quadWays.count(q) > 0 )
+      quads.push_back( std::make_pair( q, quadWays[q] ));
+    else
+      MESSAGE("NO QUAD WAY ID = "<<id);
+  }
+
+  if ( NOT _parallel ){
+    for ( size_t i = 0; i < quads.size(); ++i )
+      ok = computeQuad( *quads[i].first, quads[i].second );
+    MESSAGE("computeQuads() : end  >>>>>>>>");
+    return ok;
+  }
+
+  // 1) serial: boundary nodes, by association, by finding the geometry or
+  //    else by linear approximation, as computeQuad()
+  std::vector< QuadDiscretization > discr( quads.size() );
+  std::vector< bool >               prepared( quads.size() );
+  for ( size_t i = 0; i < quads.size(); ++i ){
+    prepared[i] = ( _prepareQuad( *quads[i].first, quads[i].second, true,  discr[i] ) ||
+                    _prepareQuadByFindingGeom( *quads[i].first, quads[i].second, discr[i] ) ||
+                    _prepareQuad( *quads[i].first, quads[i].second, false, discr[i] ));
+  }
+
+  // tasks: one per quad, those associated to the same faces next to each
+  // other so that a thread likely finds their faces already loaded
+  std::map< FaceShapesKey, std::vector<int> > quadsOfFaces;
+  for ( size_t i = 0; i < quads.size(); ++i ){
+    if ( NOT prepared[i] )
+      continue;
+    FaceShapesKey faces;
+    if ( discr[i].byAssoc && discr[i].face.IsNull() )
+      faces = discr[i].assoKey;
+    quadsOfFaces[ faces ].push_back( i );
+  }
+  std::vector<int> tasks;
+  tasks.reserve( quads.size() );
+  std::map< FaceShapesKey, std::vector<int> >::const_iterator q2f = quadsOfFaces.begin();
+  for ( ; q2f != quadsOfFaces.end(); ++q2f )
+    tasks.insert( tasks.end(), q2f->second.begin(), q2f->second.end() );
+
+  // 2) parallel: inner points
+  if ( NOT tasks.empty() ){
+    OSD_ThreadPool::Launcher launcher( *OSD_ThreadPool::DefaultPool(), (int) tasks.size() );
+    std::vector< IntersectorCache > intersectors( launcher.UpperThreadIndex() + 1 );
+    launcher.Perform( 0, (int) tasks.size(),
+                      QuadPointsFunctor( this, discr, tasks, intersectors ));
+    for ( size_t t = 0; t < intersectors.size(); ++t )
+      _intersectors.addStats( intersectors[t] );
+  }
+
+  // 3) serial: nodes and faces, in the same order as in serial mode
+  for ( size_t i = 0; i < quads.size(); ++i ){
+    if ( NOT prepared[i] ){
+      ok = false;
+      continue;
+    }
+    ok = _commitQuad( discr[i] );
+    _computeQuadOK = true;
+  }
+
+  MESSAGE("computeQuads() : end  >>>>>>>>");
   return ok;
 }
 
 
+// A skin quad without association is meshed on the face of the shape to
+// mesh where its boundary nodes are, if any
 bool SMESH_HexaBlocks::computeQuadByFindingGeom( HEXA_NS::Quad& quad, bool way )
 {
-  MESSAGE("computeQuadByFindingGeom() not implemented");
+  MESSAGE("computeQuadByFindingGeom() : : begin   <<<<<<");
+  MESSAGE("quadID = "<<quad.getId());
+
+  ASSERT( _computeEdgeOK );
+  QuadDiscretization discr;
+  if ( NOT _prepareQuadByFindingGeom( quad, way, discr )){
+    MESSAGE("computeQuadByFindingGeom() : end  >>>>>>>>");
+    return false;
+  }
+  _computeQuadPoints( discr, _intersectors );
+  bool ok = _commitQuad( discr );
+
+  MESSAGE("computeQuadByFindingGeom() : end  >>>>>>>>");
+  return ok;
+}
+
+// =============================================== _prepareQuadByFindingGeom
+// The candidate faces are near the 4 corners; the nearest one on which the
+// whole boundary projects is taken. Serial: builds the face tree once.
+bool SMESH_HexaBlocks::_prepareQuadByFindingGeom( HEXA_NS::Quad& quad, bool way,
+                                                  QuadDiscretization& discr )
+{
+  if ( quad.countAssociation() > 0 || quad.getNbrParents() > 1 )
+    return false;
+  if ( NOT _theMesh->HasShapeToMesh() )
+    return false;
+  if ( NOT _prepareQuad( quad, way, false, discr ))
+    return false;
+
+  if ( NOT _faceTree.isBuilt() )
+    _faceTree.build( _theMesh->GetShapeToMesh() );
+
+  const QuadGrid& nodesOnQuad = discr.nodesOnQuad;
+  int iSize = nodesOnQuad.iSize();
+  int jSize = nodesOnQuad.jSize();
+  gp_Pnt corners[4] = { nodesOnQuad.point(0, 0),       nodesOnQuad.point(iSize-1, 0),
+                        nodesOnQuad.point(iSize-1, jSize-1), nodesOnQuad.point(0, jSize-1) };
+
+  // faces near all the corners
+  std::vector<int> candidates, near, common;
+  for ( int c = 0; c < 4; ++c ){
+    _faceTree.findNear( corners[c], HEXA_UV_GAP, near );
+    if ( c == 0 ){
+      candidates.swap( near );
+    } else {
+      common.clear();
+      std::set_intersection( candidates.begin(), candidates.end(),
+                             near.begin(), near.end(), std::back_inserter( common ));
+      candidates.swap( common );
+    }
+    if ( candidates.empty() ){
+      MESSAGE("_prepareQuadByFindingGeom() : no face near the corners");
+      return false;
+    }
+  }
+
+  // the nearest faces first
+  std::vector< std::pair<double, int> > byGap;
+  for ( size_t k = 0; k < candidates.size(); ++k ){
+    const TopoDS_Face& face = _faceTree.face( candidates[k] );
+    Handle(ShapeAnalysis_Surface) sas = new ShapeAnalysis_Surface( BRep_Tool::Surface( face ));
+    double tol = std::max( 10.*BRep_Tool::Tolerance( face ), HEXA_UV_GAP );
+    double gap = 0.;
+    for ( int c = 0; c < 4 && gap <= tol; ++c ){
+      sas->ValueOfUV( corners[c], tol );
+      gap = std::max( gap, sas->Gap() );
+    }
+    if ( gap <= tol )
+      byGap.push_back( std::make_pair( gap, candidates[k] ));
+  }
+  std::sort( byGap.begin(), byGap.end() );
+
+  for ( size_t k = 0; k < byGap.size(); ++k ){
+    const TopoDS_Face& face = _faceTree.face( byGap[k].second );
+    if ( _projectQuadBoundary( face, nodesOnQuad, discr.uvOnQuad )){
+      discr.face = face;
+      return true;
+    }
+  }
+  discr.uvOnQuad.clear();
+  MESSAGE("_prepareQuadByFindingGeom() : no face under the boundary");
   return false;
 }
 
+// ================================================================ FaceTree
+void SMESH_HexaBlocks::FaceTree::build( const TopoDS_Shape& shape )
+{
+  _built = true;
+  TopTools_IndexedMapOfShape faces;
+  TopExp::MapShapes( shape, TopAbs_FACE, faces );
+  for ( int i = 1; i <= faces.Extent(); ++i ){
+    Bnd_Box bndBox;
+    BRepBndLib::Add( faces( i ), bndBox );
+    if ( bndBox.IsVoid() )
+      continue;
+    Box box;
+    bndBox.Get( box.min[0], box.min[1], box.min[2], box.max[0], box.max[1], box.max[2] );
+    _faces.push_back( TopoDS::Face( faces( i )));
+    _boxes.push_back( box );
+    _order.push_back( _order.size() );
+  }
+  _nodes.reserve( 2*_faces.size() );
+  if ( NOT _faces.empty() )
+    _build( 0, _faces.size() );
+}
+
+// Median split on the largest extent of the centers; leaves of 4 faces at most
+int SMESH_HexaBlocks::FaceTree::_build( int first, int last )
+{
+  int iNode = _nodes.size();
+  _nodes.push_back( Node() );
+  Node node;
+  node.first = first;
+  node.last  = last;
+  node.left  = -1;
+  node.right = -1;
+  for ( int k = 0; k < 3; ++k ){
+    node.box.min[k] =  Precision::Infinite();
+    node.box.max[k] = -Precision::Infinite();
+  }
+  double cMin[3] = {  Precision::Infinite(),  Precision::Infinite(),  Precision::Infinite() };
+  double cMax[3] = { -Precision::Infinite(), -Precision::Infinite(), -Precision::Infinite() };
+  for ( int i = first; i < last; ++i ){
+    const Box& box = _boxes[ _order[i] ];
+    for ( int k = 0; k < 3; ++k ){
+      node.box.min[k] = std::min( node.box.min[k], box.min[k] );
+      node.box.max[k] = std::max( node.box.max[k], box.max[k] );
+      double center = 0.5*( box.min[k] + box.max[k] );
+      cMin[k] = std::min( cMin[k], center );
+      cMax[k] = std::max( cMax[k], center );
+    }
+  }
+  if ( last - first > 4 ){
+    int axis = 0;
+    for ( int k = 1; k < 3; ++k )
+      if ( cMax[k] - cMin[k] > cMax[axis] - cMin[axis] )
+        axis = k;
+    std::vector< std::pair<double, int> > centers;
+    for ( int i = first; i < last; ++i ){
+      const Box& box = _boxes[ _order[i] ];
+      centers.push_back( std::make_pair( box.min[axis] + box.max[axis], _order[i] ));
+    }
+    int middle = ( last - first ) / 2;
+    std::nth_element( centers.begin(), centers.begin() + middle, centers.end() );
+    for ( int i = first; i < last; ++i )
+      _order[i] = centers[ i - first ].second;
+
+    node.left  = _build( first, first + middle );
+    node.right = _build( first + middle, last );
+  }
+  _nodes[ iNode ] = node;
+  return iNode;
+}
+
+void SMESH_HexaBlocks::FaceTree::findNear( const gp_Pnt& p, double tol,
+                                           std::vector<int>& found ) const
+{
+  found.clear();
+  if ( _nodes.empty() )
+    return;
+  std::vector<int> stack( 1, 0 );
+  while ( NOT stack.empty() ){
+    const Node& node = _nodes[ stack.back() ];
+    stack.pop_back();
+    if ( node.box.isOut( p, tol ))
+      continue;
+    if ( node.left < 0 ){
+      for ( int i = node.first; i < node.last; ++i )
+        if ( NOT _boxes[ _order[i] ].isOut( p, tol ))
+          found.push_back( _order[i] );
+    } else {
+      stack.push_back( node.left );
+      stack.push_back( node.right );
+    }
+  }
+  std::sort( found.begin(), found.end() );
+}
+
+bool SMESH_HexaBlocks::FaceTree::Box::isOut( const gp_Pnt& p, double tol ) const
+{
+  return ( p.X() < min[0] - tol || p.X() > max[0] + tol ||
+           p.Y() < min[1] - tol || p.Y() > max[1] + tol ||
+           p.Z() < min[2] - tol || p.Z() > max[2] + tol );
+}
+
 bool SMESH_HexaBlocks::_computeQuadInit(
   HEXA_NS::Quad& quad,
-  ArrayOfSMESHNodes& nodesOnQuad,
+  QuadGrid& nodesOnQuad,
   std::vector<double>& xx, std::vector<double>& yy)
 {
   MESSAGE("_computeQuadInit() : begin ---------------");
@@ -865,11 +1461,11 @@ bool SMESH_HexaBlocks::_computeQuadInit(
     ASSERT(false);
   }
 
-  SMESHNodes hNodes = _nodesOnEdge[eh];
-  SMESHNodes bNodes = _nodesOnEdge[eb];
-  SMESHNodes gNodes = _nodesOnEdge[eg];
-  SMESHNodes dNodes = _nodesOnEdge[ed];
-  nodesOnQuad.resize( bNodes.size(), SMESHNodes(gNodes.size(), static_cast<SMDS_MeshNode*>(NULL)) );
+  const SMESHNodes& hNodes = _nodesOnEdge[eh];
+  const SMESHNodes& bNodes = _nodesOnEdge[eb];
+  const SMESHNodes& gNodes = _nodesOnEdge[eg];
+  const SMESHNodes& dNodes = _nodesOnEdge[ed];
+  nodesOnQuad.resize( bNodes.size(), gNodes.size() );
 
 
   int i, j, _i, _j;
@@ -904,8 +1500,8 @@ bool SMESH_HexaBlocks::_computeQuadInit(
   //bNodes, hNodes
   double u;
   for (i = 0, _i = bNodes.size()-1; i < bNodes.size(); ++i, --_i){
-    nodesOnQuad[i][0]                = bNodes[*b_i];
-    nodesOnQuad[i][gNodes.size()-1 ] = hNodes[*h_i];
+    nodesOnQuad.node(i, 0)                 = bNodes[*b_i];
+    nodesOnQuad.node(i, gNodes.size()-1 )  = hNodes[*h_i];
 
     u = _nodeXx[ bNodes[*b_i] ];
     if ( uWay == true ){
@@ -914,20 +1510,20 @@ bool SMESH_HexaBlocks::_computeQuadInit(
       xx.push_back(1.-u);
     }
   }
-  if ( S1 != nodesOnQuad[0][0] ){
+  if ( S1 != nodesOnQuad.node(0, 0) ){
     MESSAGE("ZZZZZZZZZZZZZZZZ quadID = "<<quad.getId());
   }
-//   ASSERT( S1 == nodesOnQuad[0][0] );
+//   ASSERT( S1 == nodesOnQuad.node(0, 0) );
 
   //gNodes, dNodes
   double v;
   for (j = 0, _j = gNodes.size()-1; j < gNodes.size(); ++j, --_j){
-    nodesOnQuad[0][j] = gNodes[*g_j];
-    if ( S1 != nodesOnQuad[0][0] ){
+    nodesOnQuad.node(0, j) = gNodes[*g_j];
+    if ( S1 != nodesOnQuad.node(0, 0) ){
       MESSAGE("XXXXXXXXXXXXXXXX quadID = "<<quad.getId());
     }
-//     ASSERT( S1 == nodesOnQuad[0][0] );
-    nodesOnQuad[bNodes.size()-1][j] = dNodes[*d_j];
+//     ASSERT( S1 == nodesOnQuad.node(0, 0) );
+    nodesOnQuad.node(bNodes.size()-1, j) = dNodes[*d_j];
     v = _nodeXx[ gNodes[*g_j] ];
     if ( vWay == true ){
       yy.push_back(v);
@@ -937,15 +1533,23 @@ bool SMESH_HexaBlocks::_computeQuadInit(
   }
 
 
-  int iSize = nodesOnQuad.size();
-  int jSize = nodesOnQuad[0].size();
+  int iSize = nodesOnQuad.iSize();
+  int jSize = nodesOnQuad.jSize();
   ASSERT( iSize = bNodes.size() );
   ASSERT( jSize = gNodes.size() );
 
-//   ASSERT( S1 == nodesOnQuad[0][0] );
-//   ASSERT( S2 == nodesOnQuad[iSize-1][0]);
-//   ASSERT( S4 == nodesOnQuad[0][jSize-1]);
-//   ASSERT( S3 == nodesOnQuad[iSize-1][jSize-1]);
+  // points of the boundary nodes
+  for (i = 0; i < iSize; ++i)
+    for (j = 0; j < jSize; ++j){
+      const SMDS_MeshNode* n = nodesOnQuad.node(i, j);
+      if ( n != NULL )
+        nodesOnQuad.point(i, j) = gp_Pnt( n->X(), n->Y(), n->Z() );
+    }
+
+//   ASSERT( S1 == nodesOnQuad.node(0, 0) );
+//   ASSERT( S2 == nodesOnQuad.node(iSize-1, 0));
+//   ASSERT( S4 == nodesOnQuad.node(0, jSize-1));
+//   ASSERT( S3 == nodesOnQuad.node(iSize-1, jSize-1));
 
   return ok;
 }
@@ -960,69 +1564,12 @@ bool SMESH_HexaBlocks::computeQuadByLinearApproximation( HEXA_NS::Quad& quad, bo
   MESSAGE("quadID = "<<quad.getId());
 
   ASSERT( _computeEdgeOK );
-  bool ok = true;
-
-  ArrayOfSMESHNodes nodesOnQuad; // nodes in this quad ( to be added on the mesh )
-  SMESHFaces      facesOnQuad;
-  SMDS_MeshFace*  newFace = NULL;
-  std::vector<double> xx, yy;
-
-  // Elements for quad computation
-  SMDS_MeshNode *S1, *S2, *S4, *S3;
-
-//   bool initOk = _computeQuadInit( quad, eh, eb, eg, ed, S1, S2, S3, S4 );
-  bool initOk = _computeQuadInit( quad, nodesOnQuad, xx, yy );
-  if ( initOk == false ){
+  QuadDiscretization discr;
+  if ( NOT _prepareQuad( quad, way, false, discr )){
     return false;
   }
-
-  int iSize = nodesOnQuad.size();
-  int jSize = nodesOnQuad[0].size();
-
-  S1 = nodesOnQuad[0][0];
-//   S2 = nodesOnQuad[bNodes.size()-1][0];
-  S2 = nodesOnQuad[iSize-1][0];
-  S4 = nodesOnQuad[0][jSize-1];
-  S3 = nodesOnQuad[iSize-1][jSize-1];
-
-  for (int j = 1; j < jSize; ++j){
-    for (int i = 1; i < iSize; ++i){
-        SMDS_MeshNode* n1 = nodesOnQuad[i-1][j];
-        SMDS_MeshNode* n2 = nodesOnQuad[i-1][j-1];
-        SMDS_MeshNode* n3 = nodesOnQuad[i][j-1];
-        SMDS_MeshNode* n4 = nodesOnQuad[i][j];
-
-        if ( n4 == NULL ){
-            double newNodeX, newNodeY, newNodeZ;
-            SMDS_MeshNode* Ph = nodesOnQuad[i][jSize-1];   //dNodes[h_i];
-            SMDS_MeshNode* Pb = nodesOnQuad[i][0];   //bNodes[b_i];
-            SMDS_MeshNode* Pg = nodesOnQuad[0][j];   //gNodes[g_j];
-            SMDS_MeshNode* Pd = nodesOnQuad[iSize-1][j];  //dNodes[d_j];
-            double u = xx[i];
-            double v = yy[j];
-
-            _nodeInterpolationUV(u, v, Pg, Pd, Ph, Pb, S1, S2, S3, S4, newNodeX, newNodeY, newNodeZ);
-            n4 = _theMeshDS->AddNode( newNodeX, newNodeY, newNodeZ );
-            nodesOnQuad[i][j] = n4;
-        }
-
-        MESSAGE("n1 (" << n1->X() << "," << n1->Y() << "," << n1->Z() << ")");
-        MESSAGE("n2 (" << n2->X() << "," << n2->Y() << "," << n2->Z() << ")");
-        MESSAGE("n4 (" << n4->X() << "," << n4->Y() << "," << n4->Z() << ")");
-        MESSAGE("n3 (" << n3->X() << "," << n3->Y() << "," << n3->Z() << ")");
-
-        if ( way == true ){
-            MESSAGE("AddFace( n1, n2, n3, n4 )");
-            newFace = _theMeshDS->AddFace( n1, n2, n3, n4 );
-        } else {
-            MESSAGE("AddFace( n4, n3, n2, n1 )");
-            newFace = _theMeshDS->AddFace( n4, n3, n2, n1 );
-        }
-        facesOnQuad.push_back(newFace);
-      }
-  }
-  _quadNodes[ &quad ] = nodesOnQuad;
-  _facesOnQuad[&quad] = facesOnQuad;
+  _computeQuadPoints( discr, _intersectors );
+  bool ok = _commitQuad( discr );
 
   MESSAGE("computeQuadByLinearApproximation() : end  >>>>>>>>");
   return ok;
@@ -1037,6 +1584,21 @@ bool SMESH_HexaBlocks::computeHexa( HEXA_NS::Document* doc )
   MESSAGE("computeHexa() : : begin   <<<<<<");
   bool ok=false;
 
+  // the blocks are the hexas of the document if their quads allow it
+  bool byQuads = false;
+  try {
+      byQuads = computeHexaByQuads( doc );
+  } catch(...) {
+    MESSAGE("computeHexaByQuads error!!! ");
+    MESSAGE("computeHexa() : end  >>>>>>>>");
+    return false; // the volumes may be partly built
+  }
+  if ( byQuads ){
+    MESSAGE("computeHexa() : end  >>>>>>>>");
+    return true;
+  }
+
+  // else the blocks are searched on the skin of the mesh
   SMESH_MesherHelper aHelper(*_theMesh);
   TopoDS_Shape shape = _theMesh->GetShapeToMesh();
   aHelper.SetSubShape( shape );
@@ -1044,6 +1606,7 @@ bool SMESH_HexaBlocks::computeHexa( HEXA_NS::Document* doc )
 
   SMESH_Gen* gen = _theMesh->GetGen();
   SMESH_HexaFromSkin_3D algo( 0, gen, doc );
+  algo.SetParallel( _parallel );
   algo.InitComputeError();
   try {
       ok = algo.Compute( *_theMesh, &aHelper, _volumesOnHexa, _node );
@@ -1057,6 +1620,279 @@ bool SMESH_HexaBlocks::computeHexa( HEXA_NS::Document* doc )
   return ok;
 }
 
+// ======================================================= HexaPointsFunctor
+struct SMESH_HexaBlocks::HexaPointsFunctor
+{
+  const SMESH_HexaBlocks*                    _builder;
+  std::vector< SMESH_HexaBlocks::HexaGrid >& _grids;
+
+  HexaPointsFunctor( const SMESH_HexaBlocks* builder,
+                     std::vector< SMESH_HexaBlocks::HexaGrid >& grids ):
+    _builder( builder ), _grids( grids ) {}
+
+  void operator()( const int j ) const
+  {
+    try {
+      _builder->_computeHexaPoints( _grids[j] );
+    } catch(...) {
+      _grids[j].done = false; // recomputed at commit
+    }
+  }
+};
+
+// ====================================================== computeHexaByQuads
+// The blocks are the hexas of the document and their sides the quads,
+// meshed by computeQuads(): the nodes on the sides are known, only the
+// inner ones are computed. Nothing is added unless all the hexas can be
+// built so.
+bool SMESH_HexaBlocks::computeHexaByQuads( HEXA_NS::Document* doc )
+{
+  MESSAGE("computeHexaByQuads() : : begin   <<<<<<");
+  int nHexa = doc->countUsedHexa();
+  std::vector< HexaGrid > grids( nHexa );
+  for ( int j = 0; j < nHexa; ++j ){
+    if ( NOT _prepareHexa( *doc->getUsedHexa(j), grids[j] )){
+      MESSAGE("computeHexaByQuads() : no grid for hexa ID = "<<doc->getUsedHexa(j)->getId());
+      return false;
+    }
+  }
+
+  SMESH_MesherHelper aHelper(*_theMesh);
+  aHelper.SetSubShape( _theMesh->GetShapeToMesh() );
+  aHelper.SetElementsOnShape( true );
+  for ( int j = 0; j < nHexa; ++j ){
+    // inner points of the next hexas, computed in parallel
+    if ( _parallel && j % HEXA_POINTS_BATCH == 0 )
+      OSD_Parallel::For( j, std::min( j + HEXA_POINTS_BATCH, nHexa ), HexaPointsFunctor( this, grids ));
+
+    _commitHexa( grids[j], aHelper );
+    std::vector<const SMDS_MeshNode*>().swap( grids[j].nodes );
+    std::vector<gp_XYZ>().swap( grids[j].points );
+  }
+
+  MESSAGE("computeHexaByQuads() : end  >>>>>>>>");
+  return true;
+}
+
+// ============================================================ _prepareHexa
+// The corners of the hexa are placed in the grid by its first quad and its
+// edges from it; each quad grid is then copied between its corners.
+bool SMESH_HexaBlocks::_prepareHexa( HEXA_NS::Hexa& hexa, HexaGrid& grid )
+{
+  if ( hexa.countQuad() != 6 )
+    return false;
+  std::map<HEXA_NS::Quad*, QuadGrid>::const_iterator q0 = _quadNodes.find( hexa.getQuad(0) );
+  if ( q0 == _quadNodes.end() )
+    return false;
+  const QuadGrid& bottom = q0->second;
+  int X = bottom.iSize() - 1, Y = bottom.jSize() - 1, Z = -1;
+
+  // corners: nodes and indices ( x, y, z )
+  const SMDS_MeshNode* corners[8] = { bottom.node(0, 0), bottom.node(X, 0),
+                                      bottom.node(0, Y), bottom.node(X, Y),
+                                      NULL, NULL, NULL, NULL };
+  int index[8][3] = { {0,0,0}, {X,0,0}, {0,Y,0}, {X,Y,0},
+                      {0,0,0}, {X,0,0}, {0,Y,0}, {X,Y,0} };
+  for ( int i = 0; i < hexa.countEdge(); ++i ){
+    HEXA_NS::Edge* e = hexa.getEdge(i);
+    std::map<HEXA_NS::Vertex*, SMDS_MeshNode*>::const_iterator n0 = _node.find( e->getVertex(0) );
+    std::map<HEXA_NS::Vertex*, SMDS_MeshNode*>::const_iterator n1 = _node.find( e->getVertex(1) );
+    if ( n0 == _node.end() || n1 == _node.end() )
+      return false;
+    int c0 = std::find( corners, corners + 4, n0->second ) - corners;
+    int c1 = std::find( corners, corners + 4, n1->second ) - corners;
+    if (( c0 < 4 ) == ( c1 < 4 )) // edge of the first quad or of the opposite one
+      continue;
+    std::map<HEXA_NS::Edge*, SMESHNodes>::const_iterator nodes = _nodesOnEdge.find( e );
+    if ( nodes == _nodesOnEdge.end() || ( Z >= 0 && Z != (int) nodes->second.size() - 1 ))
+      return false;
+    Z = nodes->second.size() - 1;
+    if ( c0 < 4 ) corners[ 4 + c0 ] = n1->second;
+    else          corners[ 4 + c1 ] = n0->second;
+  }
+  if ( Z < 1 || X < 1 || Y < 1 )
+    return false;
+  for ( int c = 4; c < 8; ++c ){
+    if ( corners[c] == NULL )
+      return false;
+    index[c][2] = Z;
+  }
+
+  grid.hexa  = &hexa;
+  grid.xSize = X + 1;
+  grid.ySize = Y + 1;
+  grid.zSize = Z + 1;
+  grid.nodes.assign( grid.xSize * grid.ySize * grid.zSize, (const SMDS_MeshNode*) NULL );
+
+  for ( int k = 0; k < hexa.countQuad(); ++k ){
+    std::map<HEXA_NS::Quad*, QuadGrid>::const_iterator q = _quadNodes.find( hexa.getQuad(k) );
+    if ( q == _quadNodes.end() )
+      return false;
+    const QuadGrid& side = q->second;
+    int I = side.iSize() - 1, J = side.jSize() - 1;
+
+    // corners of the side in the grid: A at (0,0), B at (I,0), C at (0,J)
+    const SMDS_MeshNode* sideCorners[4] = { side.node(0, 0), side.node(I, 0),
+                                            side.node(0, J), side.node(I, J) };
+    int c[4];
+    for ( int iC = 0; iC < 4; ++iC ){
+      c[iC] = std::find( corners, corners + 8, sideCorners[iC] ) - corners;
+      if ( c[iC] == 8 )
+        return false;
+    }
+    int di[3], dj[3], nbI = 0, nbJ = 0;
+    for ( int a = 0; a < 3; ++a ){
+      di[a] = index[ c[1] ][a] - index[ c[0] ][a];
+      dj[a] = index[ c[2] ][a] - index[ c[0] ][a];
+      if ( di[a] != 0 ){ if ( abs( di[a] ) != I ) return false; di[a] /= I; ++nbI; }
+      if ( dj[a] != 0 ){ if ( abs( dj[a] ) != J ) return false; dj[a] /= J; ++nbJ; }
+      if ( index[ c[3] ][a] != index[ c[0] ][a] + di[a]*I + dj[a]*J )
+        return false;
+    }
+    if ( nbI != 1 || nbJ != 1 )
+      return false;
+
+    for ( int i = 0; i <= I; ++i )
+      for ( int j = 0; j <= J; ++j ){
+        const SMDS_MeshNode*& n = grid.node( index[ c[0] ][0] + i*di[0] + j*dj[0],
+                                             index[ c[0] ][1] + i*di[1] + j*dj[1],
+                                             index[ c[0] ][2] + i*di[2] + j*dj[2] );
+        if ( n != NULL && n != side.node(i, j) ) // sides not sharing their edges
+          return false;
+        n = side.node(i, j);
+      }
+  }
+
+  // two quads on the same side of the box leave another side empty
+  for ( int x = 0; x <= X; ++x )
+    for ( int y = 0; y <= Y; ++y ){
+      bool onSide = ( x == 0 || x == X || y == 0 || y == Y );
+      for ( int z = 0; z <= Z; z += ( onSide ? 1 : Z ))
+        if ( grid.node( x, y, z ) == NULL )
+          return false;
+    }
+  return true;
+}
+
+// ====================================================== _computeHexaPoints
+// Inner points by SMESH_Block::ShellPoint, in the same way as
+// SMESH_HexaFromSkin_3D does for the blocks it finds. Only reads the grid
+// and its nodes: may run concurrently for different hexas
+void SMESH_HexaBlocks::_computeHexaPoints( HexaGrid& grid ) const
+{
+  int x, y, z;
+  int xSize = grid.xSize, ySize = grid.ySize, zSize = grid.zSize;
+  int X = xSize - 1, Y = ySize - 1, Z = zSize - 1;
+  grid.points.clear();
+  grid.points.reserve( std::max( 0, (xSize-2)*(ySize-2)*(zSize-2) ));
+
+  std::vector<gp_XYZ> pointOnShape( SMESH_Block::ID_Shell );
+#define HEXA_GRID_XYZ(x, y, z) \
+  gp_XYZ( grid.node(x, y, z)->X(), grid.node(x, y, z)->Y(), grid.node(x, y, z)->Z() )
+
+  // projections on vertices are constant
+  pointOnShape[ SMESH_Block::ID_V000 ] = HEXA_GRID_XYZ( 0, 0, 0 );
+  pointOnShape[ SMESH_Block::ID_V100 ] = HEXA_GRID_XYZ( X, 0, 0 );
+  pointOnShape[ SMESH_Block::ID_V010 ] = HEXA_GRID_XYZ( 0, Y, 0 );
+  pointOnShape[ SMESH_Block::ID_V110 ] = HEXA_GRID_XYZ( X, Y, 0 );
+  pointOnShape[ SMESH_Block::ID_V001 ] = HEXA_GRID_XYZ( 0, 0, Z );
+  pointOnShape[ SMESH_Block::ID_V101 ] = HEXA_GRID_XYZ( X, 0, Z );
+  pointOnShape[ SMESH_Block::ID_V011 ] = HEXA_GRID_XYZ( 0, Y, Z );
+  pointOnShape[ SMESH_Block::ID_V111 ] = HEXA_GRID_XYZ( X, Y, Z );
+
+  for ( x = 1; x < xSize-1; ++x ){
+    gp_XYZ params; // normalized parameters of internal node within a unit box
+    params.SetCoord( 1, x / double(X) );
+    for ( y = 1; y < ySize-1; ++y ){
+      params.SetCoord( 2, y / double(Y) );
+      // projections on horizontal edges
+      pointOnShape[ SMESH_Block::ID_Ex00 ] = HEXA_GRID_XYZ( x, 0, 0 );
+      pointOnShape[ SMESH_Block::ID_Ex10 ] = HEXA_GRID_XYZ( x, Y, 0 );
+      pointOnShape[ SMESH_Block::ID_E0y0 ] = HEXA_GRID_XYZ( 0, y, 0 );
+      pointOnShape[ SMESH_Block::ID_E1y0 ] = HEXA_GRID_XYZ( X, y, 0 );
+      pointOnShape[ SMESH_Block::ID_Ex01 ] = HEXA_GRID_XYZ( x, 0, Z );
+      pointOnShape[ SMESH_Block::ID_Ex11 ] = HEXA_GRID_XYZ( x, Y, Z );
+      pointOnShape[ SMESH_Block::ID_E0y1 ] = HEXA_GRID_XYZ( 0, y, Z );
+      pointOnShape[ SMESH_Block::ID_E1y1 ] = HEXA_GRID_XYZ( X, y, Z );
+      // projections on horizontal sides
+      pointOnShape[ SMESH_Block::ID_Fxy0 ] = HEXA_GRID_XYZ( x, y, 0 );
+      pointOnShape[ SMESH_Block::ID_Fxy1 ] = HEXA_GRID_XYZ( x, y, Z );
+      for ( z = 1; z < zSize-1; ++z ){
+        params.SetCoord( 3, z / double(Z) );
+        // projections on vertical edges
+        pointOnShape[ SMESH_Block::ID_E00z ] = HEXA_GRID_XYZ( 0, 0, z );
+        pointOnShape[ SMESH_Block::ID_E10z ] = HEXA_GRID_XYZ( X, 0, z );
+        pointOnShape[ SMESH_Block::ID_E01z ] = HEXA_GRID_XYZ( 0, Y, z );
+        pointOnShape[ SMESH_Block::ID_E11z ] = HEXA_GRID_XYZ( X, Y, z );
+        // projections on vertical sides
+        pointOnShape[ SMESH_Block::ID_Fx0z ] = HEXA_GRID_XYZ( x, 0, z );
+        pointOnShape[ SMESH_Block::ID_Fx1z ] = HEXA_GRID_XYZ( x, Y, z );
+        pointOnShape[ SMESH_Block::ID_F0yz ] = HEXA_GRID_XYZ( 0, y, z );
+        pointOnShape[ SMESH_Block::ID_F1yz ] = HEXA_GRID_XYZ( X, y, z );
+
+        // compute internal node coordinates
+        gp_XYZ coords;
+        SMESH_Block::ShellPoint( params, pointOnShape, coords );
+        grid.points.push_back( coords );
+      }
+    }
+  }
+#undef HEXA_GRID_XYZ
+  grid.done = true;
+}
+
+// ============================================================= _commitHexa
+// Inner nodes and hexahedrons are added in the order of the grid
+void SMESH_HexaBlocks::_commitHexa( HexaGrid& grid, SMESH_MesherHelper& helper )
+{
+  int x, y, z;
+  int xSize = grid.xSize, ySize = grid.ySize, zSize = grid.zSize;
+  int X = xSize - 1, Y = ySize - 1, Z = zSize - 1;
+
+  // ----------------------------
+  // Add internal nodes of a box
+  // ----------------------------
+  if ( NOT grid.done ) // serial mode or failed in parallel
+    _computeHexaPoints( grid );
+  size_t iPoint = 0;
+  for ( x = 1; x < xSize-1; ++x )
+    for ( y = 1; y < ySize-1; ++y )
+      for ( z = 1; z < zSize-1; ++z, ++iPoint ){
+        const gp_XYZ& coords = grid.points[ iPoint ];
+        grid.node(x, y, z) = helper.AddNode( coords.X(), coords.Y(), coords.Z() );
+      }
+
+  // ----------------
+  // Add hexahedrons
+  // ----------------
+  // find out orientation
+  SMDS_VolumeOfNodes probeVolume( grid.node(0, 0, 0), grid.node(0, Y, 0),
+                                  grid.node(X, Y, 0), grid.node(X, 0, 0),
+                                  grid.node(0, 0, Z), grid.node(0, Y, Z),
+                                  grid.node(X, Y, Z), grid.node(X, 0, Z) );
+  bool isForw = SMDS_VolumeTool( &probeVolume ).IsForward();
+
+  SMESHVolumes& volumesOnHexa = _volumesOnHexa[ grid.hexa ];
+  volumesOnHexa.reserve( X*Y*Z );
+  for ( x = 0; x < xSize-1; ++x ){
+    for ( y = 0; y < ySize-1; ++y ){
+      const SMDS_MeshNode** col00 = &grid.node( x,   y,   0 );
+      const SMDS_MeshNode** col10 = &grid.node( x+1, y,   0 );
+      const SMDS_MeshNode** col01 = &grid.node( x,   y+1, 0 );
+      const SMDS_MeshNode** col11 = &grid.node( x+1, y+1, 0 );
+      // bottom face normal of a hexa mush point outside the volume
+      for ( z = 0; z < zSize-1; ++z ){
+        if ( isForw )
+          volumesOnHexa.push_back( helper.AddVolume( col00[z],   col01[z],   col11[z],   col10[z],
+                                                     col00[z+1], col01[z+1], col11[z+1], col10[z+1] ));
+        else
+          volumesOnHexa.push_back( helper.AddVolume( col00[z],   col10[z],   col11[z],   col01[z],
+                                                     col00[z+1], col10[z+1], col11[z+1], col01[z+1] ));
+      }
+    }
+  }
+}
+
 
 
 // --------------------------------------------------------------
@@ -1079,46 +1915,107 @@ bool SMESH_HexaBlocks::computeDoc(  HEXA_NS::Document* doc )
   }
 
   // B) Edges computation
-  int nbPropa = 0;
-  HEXA_NS::Propagation* propa = NULL;
-  HEXA_NS::Law*         law   = NULL;
-  HEXA_NS::Edges edges;
+  ok = computeEdges(doc);
 
-  nbPropa = doc->countPropagation();
-  for (int j=0; j < nbPropa; ++j ){//Computing each edge's propagations of the document
-    propa = doc->getPropagation(j);
-    edges = propa->getEdges();
-    law   = propa->getLaw();
-//     ASSERT( law );
+  // C) Quad computation
+  ok = computeQuads(doc);
+  MESSAGE("computeDoc() : intersector cache hits = "<<_intersectors.nbHits()
+          <<", misses = "<<_intersectors.nbMisses());
+  MESSAGE("computeDoc() : face compounds = "<<_faceCompounds.size()
+          <<", hits = "<<_faceCompounds.nbHits()
+          <<", misses = "<<_faceCompounds.nbMisses());
+  MESSAGE("computeDoc() : local projections = "<<_projections.nbLocal
+          <<", global projections = "<<_projections.nbGlobal
+          <<", not found = "<<_projections.nbNotFound
+          <<", window retries = "<<_projections.nbRetries);
+
+  // D) Hexa computation: Calling HexaFromSkin algo
+  ok = computeHexa(doc);
+
+  MESSAGE("computeDoc() : end  >>>>>>>>");
+  doc->lockDump ();
+  return ok;
+}
+
+
+// ================================================================= countDoc
+// Every vertex gives a node, every edge of a propagation the inner nodes of
+// the law, and quads and hexas the product of the inner nodes of their edges
+// in each direction.
+SMESH_HexaBlocks::Counts SMESH_HexaBlocks::countDoc( HEXA_NS::Document* doc, int dim )
+{
+  MESSAGE("countDoc() : : begin   <<<<<<");
+  Counts counts;
+  counts.nbNodes = doc->countUsedVertex();
+  counts.nbEdges = 0;
+  counts.nbQuads = 0;
+  counts.nbHexas = 0;
+  if ( dim < 1 )
+    return counts;
+
+  // inner nodes of each edge
+  std::map<HEXA_NS::Edge*, smIdType> edgeNodes;
+  int nbPropa = doc->countPropagation();
+  for (int j=0; j < nbPropa; ++j ){
+    HEXA_NS::Propagation* propa = doc->getPropagation(j);
+    HEXA_NS::Law*         law   = propa->getLaw();
     if (law == NULL){
       law = doc->getLaw(0); // default law
     }
+    const HEXA_NS::Edges& edges = propa->getEdges();
     for( HEXA_NS::Edges::const_iterator iter = edges.begin();
         iter != edges.end();
         ++iter ){
-        ok = computeEdge(**iter, *law);
+      edgeNodes[ *iter ] = law->getNodes();
+      counts.nbNodes += law->getNodes();
+      counts.nbEdges += law->getNodes() + 1;
     }
   }
-  // C) Quad computation
-  std::map<HEXA_NS::Quad*, bool>  quadWays = computeQuadWays(doc);
-  int nQuad = doc->countUsedQuad();
-  HEXA_NS::Quad* q = NULL;
-  for (int j=0; j <nQuad; ++j ){ //Computing each quad of the document
-    q = doc->getUsedQuad(j);
-    int id = q->getId();
-    if ( quadWays.count(q) > 0 )
-      ok = computeQuad( *q, quadWays[q] );
-    else
-      MESSAGE("NO QUAD WAY ID = "<<id);
+  if ( dim < 2 )
+    return counts;
 
+  std::map<HEXA_NS::Edge*, smIdType>::const_iterator n0, n1, n2;
+  int nQuad = doc->countUsedQuad();
+  for (int j=0; j <nQuad; ++j ){
+    HEXA_NS::Quad* q = doc->getUsedQuad(j);
+    n0 = edgeNodes.find( q->getEdge(0) );
+    n1 = edgeNodes.find( q->getEdge(1) );
+    if ( n0 == edgeNodes.end() || n1 == edgeNodes.end() )
+      continue;
+    counts.nbNodes += n0->second * n1->second;
+    counts.nbQuads += ( n0->second + 1 ) * ( n1->second + 1 );
+  }
+  if ( dim < 3 )
+    return counts;
+
+  int nHexa = doc->countUsedHexa();
+  for (int j=0; j <nHexa; ++j ){
+    HEXA_NS::Hexa* h = doc->getUsedHexa(j);
+    HEXA_NS::Quad* q = h->getQuad(0);
+    n0 = edgeNodes.find( q->getEdge(0) );
+    n1 = edgeNodes.find( q->getEdge(1) );
+    // third direction: an edge with one vertex only on the first quad
+    n2 = edgeNodes.end();
+    for (int i=0; i < h->countEdge() && n2 == edgeNodes.end(); ++i ){
+      HEXA_NS::Edge* e = h->getEdge(i);
+      bool on0 = false, on1 = false;
+      for (int k=0; k < 4; ++k ){
+        on0 = on0 || e->getVertex(0) == q->getVertex(k);
+        on1 = on1 || e->getVertex(1) == q->getVertex(k);
+      }
+      if ( on0 != on1 )
+        n2 = edgeNodes.find( e );
+    }
+    if ( n0 == edgeNodes.end() || n1 == edgeNodes.end() || n2 == edgeNodes.end() )
+      continue;
+    counts.nbNodes += n0->second * n1->second * n2->second;
+    counts.nbHexas += ( n0->second + 1 ) * ( n1->second + 1 ) * ( n2->second + 1 );
   }
 
-  // D) Hexa computation: Calling HexaFromSkin algo
-  ok = computeHexa(doc);
-
-  MESSAGE("computeDoc() : end  >>>>>>>>");
-  doc->lockDump ();
-  return ok;
+  MESSAGE("countDoc() : nodes = "<<counts.nbNodes<<", edges = "<<counts.nbEdges
+          <<", quads = "<<counts.nbQuads<<", hexas = "<<counts.nbHexas);
+  MESSAGE("countDoc() : end  >>>>>>>>");
+  return counts;
 }
 
 
@@ -1141,58 +2038,181 @@ void SMESH_HexaBlocks::buildGroups(HEXA_NS::Document* doc)
 // --------------------------------------------------------------
 //                      PRIVATE METHODS
 // --------------------------------------------------------------
-double SMESH_HexaBlocks::_Xx( double i, HEXA_NS::Law law, double nbNodes) //, double pos0 )
+// ===================================================== LawKey::operator<
+bool SMESH_HexaBlocks::LawKey::operator<( const LawKey& k ) const
 {
-  double result;
-  double u0;
+  if ( kind    != k.kind    ) return kind    < k.kind;
+  if ( nbNodes != k.nbNodes ) return nbNodes < k.nbNodes;
+  return coeff < k.coeff;
+}
+
+// =================================================================== _Xx
+// The table is built once per law, with a bad coefficient detected before
+// any node is computed. Nodes of arithmetic and geometric laws are summed
+// from their constant increment or ratio.
+const std::vector<double>& SMESH_HexaBlocks::_Xx( HEXA_NS::Law& law )
+{
+  LawKey key;
+  key.kind    = law.getKind();
+  key.coeff   = ( key.kind == HEXA_NS::Uniform ) ? 0. : law.getCoefficient();
+  key.nbNodes = law.getNodes();
+
+  std::map< LawKey, std::vector<double> >::iterator it = _lawTables.find( key );
+  if ( it != _lawTables.end() )
+    return it->second;
 
-  HEXA_NS::KindLaw k = law.getKind();
-  double coeff       = law.getCoefficient();
-  switch (k){
+  int    nbNodes = key.nbNodes;
+  double coeff   = key.coeff;
+  double u0;
+  std::vector<double> xx( nbNodes );
+  switch (key.kind){
     case HEXA_NS::Uniform:
-        result = (i+1)/(nbNodes+1);
-        MESSAGE( "_Xx():" << " Uniform u("<<i<< ")"<< " = " << result);
+        for (int i = 0; i < nbNodes; ++i)
+          xx[i] = (i+1.)/(nbNodes+1.);
         break;
     case HEXA_NS::Arithmetic:
         u0 = 1./(nbNodes + 1.) - (coeff*nbNodes)/2.;
-//         ASSERT(u0>0);
         if ( u0 <= 0 ) throw (SALOME_Exception(LOCALIZED("Arithmetic discretization : check coefficient")));
-        if (i==0){
-          result = u0;
-        } else {
-          result = (i + 1.)*u0 + coeff*i*(i+1.)/2.;
-        };
-        MESSAGE( "_Xx():" << " Arithmetic u("<<i<< ")"<< " = " << result);
+        // u(i) = (i+1)*u0 + coeff*i*(i+1)/2
+        for (int i = 0; i < nbNodes; ++i)
+          xx[i] = ( i == 0 ) ? u0 : xx[i-1] + u0 + coeff*i;
         break;
-    case HEXA_NS::Geometric:
+    case HEXA_NS::Geometric:{
         u0 = (1.-coeff)/(1.-pow(coeff, nbNodes + 1) )  ;
-//         ASSERT(u0>0);
         if ( u0 <= 0 ) throw (SALOME_Exception(LOCALIZED("Geometric discretization : check coefficient")));
-        if (i==0){
-          result = u0;
-        } else {
-          result = u0 * (1.- pow(coeff, i + 1) )/(1.-coeff) ;
-        };
-        MESSAGE( "_Xx():" << " Geometric u("<<i<< ")"<< " = " << result);
+        // u(i) = u0*(1-coeff^(i+1))/(1-coeff)
+        double step = u0;
+        for (int i = 0; i < nbNodes; ++i){
+          xx[i] = ( i == 0 ) ? u0 : xx[i-1] + step;
+          step *= coeff;
+        }
         break;
+    }
   }
-  return result;
+  MESSAGE( "_Xx(): law "<< key.kind <<", coefficient "<< coeff <<", "<< nbNodes <<" nodes");
+
+  std::vector<double>& table = _lawTables[ key ];
+  table.swap( xx );
+  return table;
 }
 
 
-// ============================================================= _edgeLength
-double SMESH_HexaBlocks::_edgeLength(const TopoDS_Edge & E)
+// ==================================================== CurveCache::Key::operator<
+bool SMESH_HexaBlocks::CurveCache::Key::operator<( const Key& k ) const
 {
-  MESSAGE("_edgeLength() : : begin   <<<<<<");
-  double UMin = 0, UMax = 0;
-  if (BRep_Tool::Degenerated(E))
-    return 0;
-  TopLoc_Location L;
-  Handle(Geom_Curve) C = BRep_Tool::Curve(E, L, UMin, UMax);
-  GeomAdaptor_Curve AdaptCurve(C);
-  double length = GCPnts_AbscissaPoint::Length(AdaptCurve, UMin, UMax);
-  MESSAGE("_edgeLength() : end  >>>>>>>>");
-  return length;
+  if ( tshape != k.tshape ) return tshape < k.tshape;
+  if ( scale  != k.scale  ) return scale  < k.scale;
+  if ( first  != k.first  ) return first  < k.first;
+  return last < k.last;
+}
+// ============================================================ CurveCache::get
+// Arc lengths depend on the location of the edge by its scale factor only:
+// copies of a CAD edge moved by rigid motions share their table.
+const SMESH_HexaBlocks::CurveLengths&
+SMESH_HexaBlocks::CurveCache::get( const BRepAdaptor_Curve& curve )
+{
+  Key key;
+  key.tshape = curve.Edge().TShape().get();
+  key.scale  = fabs( curve.Edge().Location().Transformation().ScaleFactor() );
+  key.first  = curve.FirstParameter();
+  key.last   = curve.LastParameter();
+
+  std::map< Key, CurveLengths >::iterator it = _lengths.find( key );
+  if ( it != _lengths.end() ){
+    _nbHits++;
+    return it->second;
+  }
+  _nbMisses++;
+
+  CurveLengths& lengths = _lengths[ key ];
+  lengths.speed   = 0.;
+  lengths.byTable = false;
+  switch ( curve.GetType() ){
+  case GeomAbs_Line:
+  case GeomAbs_Circle:{
+    // constant speed: the abscissa is linear in the parameter
+    gp_Pnt p;
+    gp_Vec d1;
+    curve.D1( key.first, p, d1 );
+    lengths.speed = d1.Magnitude();
+    break;
+  }
+  case GeomAbs_Ellipse:
+    lengths.byTable = true;
+    break;
+  default:
+    break;
+  }
+
+  double step = ( key.last - key.first ) / HEXA_CURVE_SAMPLES;
+  lengths.params.resize( HEXA_CURVE_SAMPLES + 1 );
+  lengths.abscissas.resize( HEXA_CURVE_SAMPLES + 1 );
+  lengths.params[0]    = key.first;
+  lengths.abscissas[0] = 0.;
+  for ( int i = 1; i <= HEXA_CURVE_SAMPLES; ++i ){
+    lengths.params[i]    = ( i == HEXA_CURVE_SAMPLES ) ? key.last : key.first + i*step;
+    if ( lengths.speed > 0. )
+      lengths.abscissas[i] = ( lengths.params[i] - key.first ) * lengths.speed;
+    else
+      lengths.abscissas[i] = lengths.abscissas[i-1] +
+        GCPnts_AbscissaPoint::Length( curve, lengths.params[i-1], lengths.params[i] );
+  }
+  return lengths;
+}
+// ======================================================= CurveLengths::sample
+int SMESH_HexaBlocks::CurveLengths::sample( double s ) const
+{
+  if ( s < 0. || s > length() )
+    return -1;
+  int i = std::lower_bound( abscissas.begin(), abscissas.end(), s ) - abscissas.begin();
+  if ( i > 0 && s - abscissas[i-1] < abscissas[i] - s )
+    --i;
+  return i;
+}
+// ===================================================== CurveLengths::abscissa
+double SMESH_HexaBlocks::CurveLengths::abscissa( const BRepAdaptor_Curve& curve,
+                                                 double u ) const
+{
+  double first = params.front(), last = params.back();
+  if ( u < first || u > last || last <= first )
+    return -1.;
+  if ( speed > 0. )
+    return ( u - first ) * speed;
+  int i = int( ( u - first ) / ( last - first ) * ( params.size() - 1 ));
+  if ( i >= int( params.size() ) - 1 )
+    i = params.size() - 2;
+  return abscissas[i] + GCPnts_AbscissaPoint::Length( curve, params[i], u );
+}
+// ==================================================== CurveLengths::parameter
+double SMESH_HexaBlocks::CurveLengths::parameter( const BRepAdaptor_Curve& curve,
+                                                  double s ) const
+{
+  if ( speed > 0. )
+    return params.front() + s / speed;
+
+  // interval of the table containing s, linear guess inside it
+  int i = std::upper_bound( abscissas.begin(), abscissas.end(), s ) - abscissas.begin() - 1;
+  if ( i < 0 ) i = 0;
+  if ( i > int( abscissas.size() ) - 2 ) i = abscissas.size() - 2;
+  double ds = abscissas[i+1] - abscissas[i];
+  double u  = params[i];
+  if ( ds > 0. )
+    u += ( s - abscissas[i] ) / ds * ( params[i+1] - params[i] );
+
+  // Newton on the length integrated from the sample
+  gp_Pnt p;
+  gp_Vec d1;
+  for ( int iter = 0; iter < 5; ++iter ){
+    double error = s - abscissas[i] - GCPnts_AbscissaPoint::Length( curve, params[i], u );
+    if ( fabs( error ) < Precision::Confusion() )
+      break;
+    curve.D1( u, p, d1 );
+    double speed_u = d1.Magnitude();
+    if ( speed_u < Precision::Confusion() )
+      break;
+    u += error / speed_u;
+  }
+  return u;
 }
 //--+----1----+----2----+----3----+----4----+----5----+----6----+----7----+----8
 // ============================================================== _buildMyCurve
@@ -1200,17 +2220,14 @@ double SMESH_HexaBlocks::_edgeLength(const TopoDS_Edge & E)
 void SMESH_HexaBlocks::_buildMyCurve(
     const gp_Pnt&                               myCurve_pt_start,  //IN
     const gp_Pnt&				myCurve_pt_end,    //IN
-    std::list< BRepAdaptor_Curve* >& 	        myCurve_list,        //INOUT
-    double& 				        myCurve_tot_len, //INOUT
-    std::map< BRepAdaptor_Curve*, double>& 	myCurve_lengths,//INOUT
-    std::map< BRepAdaptor_Curve*, bool>& 	myCurve_ways,   //INOUT
-    std::map< BRepAdaptor_Curve*, double>&      myCurve_starts,   //INOUT
+    MyCurve&                                    myCurve,           //INOUT
+    double& 				        myCurve_tot_len,   //INOUT
     HEXA_NS::Edge& 	                        edge) // For error diagnostic
 {
     MESSAGE("_buildMyCurve() : : begin   <<<<<<");
     bool current_way  = true;
     myCurve_tot_len    = 0.;
-    BRepAdaptor_Curve* thePreviousCurve = NULL;
+    myCurve.clear();
     BRepAdaptor_Curve* theCurve         = NULL;
 
     gp_Pnt  curv_start, curv_end;
@@ -1219,6 +2236,7 @@ void SMESH_HexaBlocks::_buildMyCurve(
     double curv_length = 0;
 
     int nbass = edge.countAssociation();
+    myCurve.reserve( nbass );
     for (int nro = 0 ; nro < nbass ; ++nro)
         {
         theCurve = make_curve (curv_start, curv_end, curv_length, u_start,
@@ -1226,7 +2244,7 @@ void SMESH_HexaBlocks::_buildMyCurve(
         if (theCurve != NULL)
            {
             bool    sens   = true;
-            if ( thePreviousCurve == NULL )
+            if ( myCurve.empty() )
                {
                // setting current_way and first curve way
                if ( myCurve_pt_start.IsEqual(curv_start, HEXA_EPS) )
@@ -1264,12 +2282,12 @@ void SMESH_HexaBlocks::_buildMyCurve(
                if (    p_curv_end.IsEqual( curv_end, HEXA_EPS  )
                     || p_curv_start.IsEqual( curv_start, HEXA_EPS ) )
                   {
-                  sens  = NOT myCurve_ways[thePreviousCurve];// opposite WAY
+                  sens  = NOT myCurve.back().way;// opposite WAY
                   }
                else if (   p_curv_end.IsEqual( curv_start, HEXA_EPS )
                         || p_curv_start.IsEqual( curv_end, HEXA_EPS ) )
                   {
-                  sens  = myCurve_ways[thePreviousCurve];// same WAY
+                  sens  = myCurve.back().way;// same WAY
                   }
                else
                   {
@@ -1280,13 +2298,17 @@ void SMESH_HexaBlocks::_buildMyCurve(
                 }
             }
 
-            myCurve_list.push_back( theCurve );
-            myCurve_ways   [theCurve] = sens;
-            myCurve_starts [theCurve] = u_start;
-            myCurve_lengths[theCurve] = curv_length;
-            myCurve_tot_len          += curv_length;
+            CurveSegment segment;
+            segment.curve  = theCurve;
+            segment.way    = sens;
+            segment.uStart = u_start;
+            segment.length = curv_length;
+            segment.start  = 0.;
+            segment.lengths = &_curveCache.get( *theCurve );
+            segment.sStart  = segment.lengths->abscissa( *theCurve, u_start );
+            myCurve.push_back( segment );
+            myCurve_tot_len += curv_length;
 
-            thePreviousCurve  = theCurve;
             p_curv_start = curv_start;
             p_curv_end   = curv_end;
            }//if ( theCurveLength > 0 )
@@ -1294,9 +2316,14 @@ void SMESH_HexaBlocks::_buildMyCurve(
 
 
     if ( NOT current_way ){
-        std::list< BRepAdaptor_Curve* > tmp( myCurve_list.size() );
-        std::copy( myCurve_list.rbegin(), myCurve_list.rend(), tmp.begin() );
-        myCurve_list = tmp;
+        std::reverse( myCurve.begin(), myCurve.end() );
+    }
+
+    // abscissa of each segment start on myCurve
+    double start = 0.;
+    for ( size_t i = 0; i < myCurve.size(); ++i ){
+        myCurve[i].start = start;
+        start           += myCurve[i].length;
     }
 
     MESSAGE("current_way  was :" << current_way);
@@ -1304,106 +2331,170 @@ void SMESH_HexaBlocks::_buildMyCurve(
 }
 
 
-
-
+// ========================================================= _getPtOnMyCurve
+// Any point can be asked for. If the previous point of cursor is on the same
+// segment, the arc length is only integrated from it
 gp_Pnt SMESH_HexaBlocks::_getPtOnMyCurve(
     const double&                             myCurve_u,      //IN
-    std::map< BRepAdaptor_Curve*, bool>&      myCurve_ways,   //IN
-    std::map< BRepAdaptor_Curve*, double>&    myCurve_lengths,//IN
-    std::map< BRepAdaptor_Curve*, double>&    myCurve_starts, //IN
-    std::list< BRepAdaptor_Curve* >&          myCurve_list,        //INOUT
-    double&                                   myCurve_start ) //INOUT
-//     std::map< BRepAdaptor_Curve*, double>&  myCurve_firsts,
-//     std::map< BRepAdaptor_Curve*, double>&  myCurve_lasts,
+    const MyCurve&                            myCurve,        //IN
+    CurveCursor&                              cursor ) const  //INOUT
 {
   MESSAGE("_getPtOnMyCurve() : : begin   <<<<<<");
-  gp_Pnt ptOnMyCurve;
+  ASSERT( myCurve.size() != 0 );
 
-  // looking for curve which contains parameter myCurve_u
-  BRepAdaptor_Curve* curve      = myCurve_list.front();
-  double            curve_start = myCurve_start;
-  double            curve_end   = curve_start + myCurve_lengths[curve];
-  double            curve_u;
-  GCPnts_AbscissaPoint discret;
+  // looking for the segment which contains parameter myCurve_u: the last one
+  // starting before it
+  int iSeg = std::upper_bound( myCurve.begin(), myCurve.end(), myCurve_u,
+                               CurveSegment::startsAfter ) - myCurve.begin() - 1;
+  if ( iSeg < 0 ) iSeg = 0;
+  const CurveSegment& segment = myCurve[iSeg];
+  double curve_u;
 
-  MESSAGE("looking for curve               = "<<(long) curve);
   MESSAGE("looking for curve: curve_u      = "<<myCurve_u);
-  MESSAGE("looking for curve: curve_start  = "<<curve_start);
-  MESSAGE("looking for curve: curve_end    = "<<curve_end);
-  MESSAGE("looking for curve: curve_lenght = "<<myCurve_lengths[curve]);
-  MESSAGE("looking for curve: curve.size _lenght= "<<myCurve_list.size());
-
-  while ( !( (myCurve_u >= curve_start) &&  (myCurve_u <= curve_end) ) ) {
+  MESSAGE("looking for curve: segment      = "<<iSeg<<" / "<<myCurve.size());
+  MESSAGE("looking for curve: curve_start  = "<<segment.start);
+  MESSAGE("looking for curve: curve_lenght = "<<segment.length);
+
+  // abscissa from the segment start
+  double abscissa;
+  if ( segment.way ){
+    abscissa = myCurve_u - segment.start;
+  } else {
+    abscissa = segment.length - (myCurve_u - segment.start);
+  }
 
-    ASSERT( myCurve_list.size() != 0 );
-    myCurve_list.pop_front();
-    curve       = myCurve_list.front();
-    curve_start = curve_end;
-    curve_end   = curve_start + myCurve_lengths[curve];
+  // lines and circles are solved in closed form, ellipses from the arc
+  // length table of the curve
+  if ( segment.sStart >= 0. &&
+       ( segment.lengths->speed > 0. || segment.lengths->byTable )){
+    curve_u = segment.lengths->parameter( *segment.curve, segment.sStart + abscissa );
+    cursor.segment  = iSeg;
+    cursor.abscissa = abscissa;
+    cursor.param    = curve_u;
+    MESSAGE("_getPtOnMyCurve() : end  >>>>>>>>");
+    return segment.curve->Value( curve_u );
+  }
 
-    MESSAGE("go next curve: curve_lenght = "<<myCurve_lengths[curve]);
-    MESSAGE("go next curve: curve_start  = "<<curve_start);
-    MESSAGE("go next curve: curve_end    = "<<curve_end);
-    MESSAGE("go next curve: myCurve_u    = "<<myCurve_u);
+  // other curves: the integration starts from the nearest known point: the
+  // segment start, the previous point if it is on the same segment, or a
+  // sample of the arc length table of the curve
+  if ( cursor.segment != iSeg ){
+    cursor.segment  = iSeg;
+    cursor.abscissa = 0.;
+    cursor.param    = segment.uStart;
+  }
+  if ( segment.sStart >= 0. ){
+    int i = segment.lengths->sample( segment.sStart + abscissa );
+    if ( i >= 0 ){
+      double sampleAbscissa = segment.lengths->abscissas[i] - segment.sStart;
+      if ( fabs( abscissa - sampleAbscissa ) < fabs( abscissa - cursor.abscissa )){
+        cursor.abscissa = sampleAbscissa;
+        cursor.param    = segment.lengths->params[i];
+      }
+    }
   }
-  myCurve_start = curve_start;
 
   // compute point
-  if ( myCurve_ways[curve] ){
-    discret = GCPnts_AbscissaPoint( *curve, (myCurve_u - curve_start), myCurve_starts[curve] );
-  } else {
-    discret = GCPnts_AbscissaPoint( *curve, myCurve_lengths[curve]- (myCurve_u - curve_start), myCurve_starts[curve] );
-  }
+  GCPnts_AbscissaPoint discret( *segment.curve, abscissa - cursor.abscissa, cursor.param );
   // PutData (discret);
   ASSERT(discret.IsDone());
   curve_u = discret.Parameter();
-  ptOnMyCurve = curve->Value( curve_u );
+
+  cursor.abscissa = abscissa;
+  cursor.param    = curve_u;
 
   MESSAGE("curve found!");
   MESSAGE("curve_u = "<< curve_u);
-  MESSAGE("curve way = "<< myCurve_ways[curve]);
+  MESSAGE("curve way = "<< segment.way);
   MESSAGE("_getPtOnMyCurve() : end  >>>>>>>>");
 
-  return ptOnMyCurve;
+  return segment.curve->Value( curve_u );
 }
 
 
 
-
-void SMESH_HexaBlocks::_nodeInterpolationUV(double u, double v,
-    SMDS_MeshNode* Pg, SMDS_MeshNode* Pd, SMDS_MeshNode* Ph, SMDS_MeshNode* Pb,
-    SMDS_MeshNode* S1, SMDS_MeshNode* S2, SMDS_MeshNode* S3, SMDS_MeshNode* S4,
-    double& xOut, double& yOut, double& zOut )
+// ============================================================= _coonsPatch
+// The corners are b[0] = g[0], b[iSize-1] = d[0], h[iSize-1] = d[jSize-1]
+// and h[0] = g[jSize-1]. For a row i, the formula
+//   (1-u)g + u d + (1-v)b + v h - (1-u)(1-v)S1 - u(1-v)S2 - u v S3 - (1-u)v S4
+// is linear in v: the inner loop runs on contiguous arrays, without
+// branches, for the compiler to vectorize it
+void SMESH_HexaBlocks::_coonsPatch( int iSize, int jSize,
+                                    const double* xx, const double* yy,
+                                    const double* b,  const double* h,
+                                    const double* g,  const double* d,
+                                    double* out )
 {
-  MESSAGE("_nodeInterpolationUV() IN:");
-  MESSAGE("u ( "<< u <<" )");
-  MESSAGE("v ( "<< v <<" )");
-
-  MESSAGE("S1 (" << S1->X() << "," << S1->Y() << "," << S1->Z() << ")");
-  MESSAGE("S2 (" << S2->X() << "," << S2->Y() << "," << S2->Z() << ")");
-  MESSAGE("S4 (" << S4->X() << "," << S4->Y() << "," << S4->Z() << ")");
-  MESSAGE("S3 (" << S3->X() << "," << S3->Y() << "," << S3->Z() << ")");
-
-  MESSAGE("Pg (" << Pg->X() << "," << Pg->Y() << "," << Pg->Z() << ")");
-  MESSAGE("Pd (" << Pd->X() << "," << Pd->Y() << "," << Pd->Z() << ")");
-  MESSAGE("Ph (" << Ph->X() << "," << Ph->Y() << "," << Ph->Z() << ")");
-  MESSAGE("Pb (" << Pb->X() << "," << Pb->Y() << "," << Pb->Z() << ")");
-
-  xOut = ((1.-u)*Pg->X() + v*Ph->X() + u*Pd->X() + (1.-v)*Pb->X()) - (1.-u)*(1.-v)*S1->X() - u*(1.-v)*S2->X() - u*v*S3->X() - (1.-u)*v*S4->X();
-  yOut = ((1.-u)*Pg->Y() + v*Ph->Y() + u*Pd->Y() + (1.-v)*Pb->Y()) - (1.-u)*(1.-v)*S1->Y() - u*(1.-v)*S2->Y() - u*v*S3->Y() - (1.-u)*v*S4->Y();
-  zOut = ((1.-u)*Pg->Z() + v*Ph->Z() + u*Pd->Z() + (1.-v)*Pb->Z()) - (1.-u)*(1.-v)*S1->Z() - u*(1.-v)*S2->Z() - u*v*S3->Z() - (1.-u)*v*S4->Z();
+  const double S1 = b[0],  S2 = b[iSize-1];
+  const double S3 = h[iSize-1], S4 = h[0];
+  for ( int i = 1; i < iSize-1; ++i ){
+    const double u  = xx[i];
+    const double c0 = b[i] - (1.-u)*S1 - u*S2; // at v = 0
+    const double c1 = h[i] - (1.-u)*S4 - u*S3; // at v = 1
+    double* row = out + i*jSize;
+    for ( int j = 1; j < jSize-1; ++j )
+      row[j] = (1.-u)*g[j] + u*d[j] + c0 + yy[j]*( c1 - c0 );
+  }
+}
 
-  MESSAGE("_nodeInterpolationUV() OUT("<<xOut<<","<<yOut<<","<<zOut<<" )");
+// ==================================================== _projectQuadBoundary
+// The boundary is walked around the quad so that each node is projected
+// near the previous one: parameters stay continuous on periodic faces.
+// Fails if a node is not on the face or if the boundary wraps around a
+// period of the face.
+bool SMESH_HexaBlocks::_projectQuadBoundary( const TopoDS_Face&        face,
+                                             const QuadGrid&           nodesOnQuad,
+                                             std::vector<gp_Pnt2d>&    uvOnQuad ) const
+{
+  Handle(Geom_Surface)          surface = BRep_Tool::Surface( face );
+  Handle(ShapeAnalysis_Surface) sas     = new ShapeAnalysis_Surface( surface );
+  double tol = std::max( 10.*BRep_Tool::Tolerance( face ), HEXA_UV_GAP );
+
+  int iSize = nodesOnQuad.iSize();
+  int jSize = nodesOnQuad.jSize();
+  std::vector< std::pair<int,int> > loop; // (i,j) counterclockwise
+  for (int i = 0; i < iSize-1; ++i)  loop.push_back( std::make_pair( i, 0 ));
+  for (int j = 0; j < jSize-1; ++j)  loop.push_back( std::make_pair( iSize-1, j ));
+  for (int i = iSize-1; i > 0; --i)  loop.push_back( std::make_pair( i, jSize-1 ));
+  for (int j = jSize-1; j > 0; --j)  loop.push_back( std::make_pair( 0, j ));
+
+  uvOnQuad.assign( iSize*jSize, gp_Pnt2d() );
+  gp_Pnt2d uv;
+  for (size_t k = 0; k <= loop.size(); ++k){
+    int i = loop[ k % loop.size() ].first;
+    int j = loop[ k % loop.size() ].second;
+    const gp_Pnt& p = nodesOnQuad.point(i, j);
+    uv = ( k == 0 ) ? sas->ValueOfUV( p, tol ) : sas->NextValueOfUV( uv, p, tol );
+    if ( sas->Gap() > tol ){
+      MESSAGE("_projectQuadBoundary() : node not on the face, gap = "<<sas->Gap());
+      return false;
+    }
+    if ( k == loop.size() ){ // back to the first node: not a period away
+      if ( surface->IsUPeriodic() &&
+           fabs( uv.X() - uvOnQuad[0].X() ) > surface->UPeriod()/2. )
+        return false;
+      if ( surface->IsVPeriodic() &&
+           fabs( uv.Y() - uvOnQuad[0].Y() ) > surface->VPeriod()/2. )
+        return false;
+      break;
+    }
+    uvOnQuad[ i*jSize + j ] = uv;
+  }
+  return true;
 }
 
 // =========================================================== getFaceShapes
-TopoDS_Shape SMESH_HexaBlocks::getFaceShapes (Hex::Quad& quad)
+TopoDS_Shape SMESH_HexaBlocks::getFaceShapes (Hex::Quad& quad) const
 {
    int             nbass = quad.countAssociation ();
    Hex::FaceShape* face  = quad.getAssociation (0);
    if (nbass==1)
        return face->getShape ();
 
+   const TopoDS_Shape* cached = _faceCompounds.find (quad);
+   if (cached != NULL)
+       return *cached;
+
    TopoDS_Compound compound;
    BRep_Builder    builder;
    builder.MakeCompound (compound);
@@ -1418,6 +2509,79 @@ TopoDS_Shape SMESH_HexaBlocks::getFaceShapes (Hex::Quad& quad)
    return compound;
 }
 
+// =========================================================== _faceShapesKey
+SMESH_HexaBlocks::FaceShapesKey SMESH_HexaBlocks::_faceShapesKey( HEXA_NS::Quad& quad )
+{
+  FaceShapesKey key;
+  for ( int nro = 0; nro < quad.countAssociation(); ++nro )
+    key.push_back( quad.getAssociation( nro ));
+  std::sort( key.begin(), key.end() );
+  return key;
+}
+
+// =========================================================== FaceCompoundCache
+const TopoDS_Shape& SMESH_HexaBlocks::FaceCompoundCache::add( HEXA_NS::Quad& quad )
+{
+  FaceShapesKey key = _faceShapesKey( quad );
+  std::map< FaceShapesKey, TopoDS_Shape >::iterator found = _compounds.find( key );
+  if ( found != _compounds.end() ){
+    _nbHits++;
+    return found->second;
+  }
+  _nbMisses++;
+
+  TopoDS_Compound compound;
+  BRep_Builder    builder;
+  builder.MakeCompound( compound );
+  for ( size_t nro = 0; nro < key.size(); ++nro )
+    builder.Add( compound, key[nro]->getShape() );
+
+  return _compounds[ key ] = compound;
+}
+
+const TopoDS_Shape* SMESH_HexaBlocks::FaceCompoundCache::find( HEXA_NS::Quad& quad ) const
+{
+  std::map< FaceShapesKey, TopoDS_Shape >::const_iterator found =
+    _compounds.find( _faceShapesKey( quad ));
+  if ( found == _compounds.end() )
+    return NULL;
+  return &found->second;
+}
+
+
+// ================================================= IntersectorCache
+static size_t HEXA_INTERSECTOR_CACHE = 16; // intersectors kept loaded
+
+SMESH_HexaBlocks::IntersectorCache::~IntersectorCache()
+{
+  for ( Entries::iterator it = _entries.begin(); it != _entries.end(); ++it )
+    delete it->second;
+}
+
+IntCurvesFace_ShapeIntersector&
+SMESH_HexaBlocks::IntersectorCache::get( const FaceShapesKey& key,
+                                         const TopoDS_Shape&  faces,
+                                         Standard_Real        tol )
+{
+  std::map< Key, Entries::iterator >::iterator found = _index.find( key );
+  if ( found != _index.end() ){
+    _nbHits++;
+    _entries.splice( _entries.begin(), _entries, found->second );
+    return *_entries.front().second;
+  }
+  _nbMisses++;
+
+  if ( _entries.size() >= HEXA_INTERSECTOR_CACHE ){
+    _index.erase( _entries.back().first );
+    delete _entries.back().second;
+    _entries.pop_back();
+  }
+  IntCurvesFace_ShapeIntersector* inter = new IntCurvesFace_ShapeIntersector;
+  inter->Load( faces, tol );
+  _entries.push_front( std::make_pair( key, inter ));
+  _index[ key ] = _entries.begin();
+  return *inter;
+}
 
 // ================================================== carre
 inline double carre (double val)
@@ -1432,29 +2596,42 @@ inline double dist2 (const gp_Pnt& pt1, const gp_Pnt& pt2)
    return dist;
 }
 // ================================================== _intersect
+// The intersector is already loaded: only the line changes from a call to
+// the next one
 gp_Pnt SMESH_HexaBlocks::_intersect( const gp_Pnt& Pt,
                                      const gp_Vec& u, const gp_Vec& v,
-                                     const TopoDS_Shape& shape,
-                                     Standard_Real tol )
+                                     IntCurvesFace_ShapeIntersector& inter,
+                                     int* iHit, int* nbRetries ) const
 {
+  if ( iHit ) *iHit = 0;
   gp_Pnt result;
 
   gp_Vec normale = u^v;
   gp_Dir dir(normale);
   gp_Lin li( Pt, dir );
 
-  Standard_Real s = -Precision::Infinite();
-  Standard_Real e = +Precision::Infinite();
-
-  IntCurvesFace_ShapeIntersector inter;
-  inter.Load(shape, tol);
-//   inter.Load(S, tol);
-  inter.Perform(li, s, e);//inter.PerformNearest(li, s, e);
+  // search window around Pt, from the size of the cell: the faces far
+  // along the line ( other sheets, other side of a closed shape ) are not
+  // intersected unless nothing is found near
+  double window = _rayWindow * std::max( u.Magnitude(), v.Magnitude() );
+  if ( window <= Precision::Confusion() )
+    window = Precision::Infinite();
+  for ( int retry = 0; ; ++retry ){
+    Standard_Real s = -window;
+    Standard_Real e = +window;
+
+    inter.Perform(li, s, e);//inter.PerformNearest(li, s, e);
+    if ( NOT inter.IsDone() || inter.NbPnt() > 0 || window >= Precision::Infinite() )
+      break;
+    window = ( retry < HEXA_RAY_RETRIES ) ? window * HEXA_RAY_GROWTH : Precision::Infinite();
+    if ( nbRetries ) ++(*nbRetries);
+  }
 
 /***********************************************  Abu 2011-11-04 */
-  if ( inter.IsDone() )
+  if ( inter.IsDone() && inter.NbPnt() > 0 )
      {
      result = inter.Pnt(1);//first
+     if ( iHit && inter.NbPnt() > 0 ) *iHit = 1;
      int nbrpts = inter.NbPnt();
      if (nbrpts>1)
         {
@@ -1466,6 +2643,7 @@ gp_Pnt SMESH_HexaBlocks::_intersect( const gp_Pnt& Pt,
                {
                d0 = d1;
                result = inter.Pnt (i);
+               if ( iHit ) *iHit = i;
                }
             }
         }
@@ -1477,107 +2655,192 @@ gp_Pnt SMESH_HexaBlocks::_intersect( const gp_Pnt& Pt,
         MESSAGE("_intersect() : pnt("<<i<<") = ("<<tmp.X()<<","<<tmp.Y()<<","<<tmp.Z()<<" )");
       }
     }
-    _found +=1;
   } else {
     MESSAGE("_intersect() : KO");
     result = Pt;
-    _notFound +=1;
   }
-  _total+=1;
 
   return result;
 }
 
-// parameters q : IN,  v0: INOUT, v1: INOUT
-void SMESH_HexaBlocks::_searchInitialQuadWay( HEXA_NS::Quad* q, HEXA_NS::Vertex*& v0, HEXA_NS::Vertex*& v1 )
-{
-  MESSAGE("_searchInitialQuadWay() : begin");
-  v0 = NULL; v1 = NULL;
-  if ( q->getNbrParents() != 1 ) return; // q must be a skin quad
-
-  HEXA_NS::Vertex* qA = q->getVertex(0);
-  HEXA_NS::Vertex* qB = q->getVertex(1);
-  HEXA_NS::Vertex* qC = q->getVertex(2);
-  HEXA_NS::Vertex* qD = q->getVertex(3);
-
-  // searching for vertex on opposed quad
-  HEXA_NS::Vertex *qAA = NULL, *qBB = NULL, *qCC = NULL, *qDD = NULL;
-  HEXA_NS::Hexa* h = q->getParent(0);
-  for( int i=0; i < h->countEdge(); ++i  ){
-    HEXA_NS::Edge* e = h->getEdge(i);
-    HEXA_NS::Vertex* e0 = e->getVertex(0);
-    HEXA_NS::Vertex* e1 = e->getVertex(1);
-
-    if ( e0 == qA && e1 != qB && e1 != qC && e1 != qD ){
-      qAA = e1;
-    } else if ( e1 == qA && e0 != qB && e0 != qC && e0 != qD ){
-      qAA = e0;
-    } else if ( e0 == qB && e1 != qA && e1 != qC && e1 != qD ){
-      qBB = e1;
-    } else if ( e1 == qB && e0 != qA && e0 != qC && e0 != qD ){
-      qBB = e0;
-    } else if ( e0 == qC && e1 != qA && e1 != qB && e1 != qD ){
-      qCC = e1;
-    } else if ( e1 == qC && e0 != qA && e0 != qB && e0 != qD ){
-      qCC = e0;
-    } else if ( e0 == qD && e1 != qA && e1 != qB && e1 != qC ){
-      qDD = e1;
-    } else if ( e1 == qD && e0 != qA && e0 != qB && e0 != qC ){
-      qDD = e0;
+// ==================================================== QuadSurfaces
+SMESH_HexaBlocks::QuadSurfaces::~QuadSurfaces()
+{
+  for ( size_t i = 0; i < surfaces.size(); ++i )
+    delete surfaces[i];
+}
+
+void SMESH_HexaBlocks::QuadSurfaces::load( const std::vector<TopoDS_Shape>& shapes )
+{
+  for ( size_t nro = 0; nro < shapes.size(); ++nro ){
+    TopExp_Explorer exp( shapes[nro], TopAbs_FACE );
+    for ( ; exp.More(); exp.Next() ){
+      faces.push_back( TopoDS::Face( exp.Current() ));
+      surfaces.push_back( new BRepAdaptor_Surface( faces.back() ));
+    }
+  }
+}
+
+int SMESH_HexaBlocks::QuadSurfaces::index( const TopoDS_Face& face ) const
+{
+  for ( size_t i = 0; i < faces.size(); ++i )
+    if ( faces[i].IsSame( face ))
+      return i;
+  return -1;
+}
+
+// =================================================== _projectOnQuad
+gp_Pnt SMESH_HexaBlocks::_projectOnQuad( const gp_Pnt& Pt,
+                                         const gp_Vec& u, const gp_Vec& v,
+                                         const QuadSurfaces& surfaces,
+                                         IntCurvesFace_ShapeIntersector& inter,
+                                         const SurfacePoint& seed,
+                                         SurfacePoint& found,
+                                         ProjectionStats& stats ) const
+{
+  gp_Pnt result;
+  gp_Vec normale = u^v;
+  if ( seed.face >= 0 && normale.Magnitude() > gp::Resolution() ){
+    found = seed;
+    if ( _localIntersect( Pt, gp_Dir( normale ), surfaces, found, result )){
+      stats.nbLocal++;
+      return result;
+    }
+  }
+
+  int iHit;
+  result = _intersect( Pt, u, v, inter, &iHit, &stats.nbRetries );
+  found = SurfacePoint();
+  if ( iHit > 0 ) stats.nbGlobal++;
+  else            stats.nbNotFound++;
+  if ( iHit > 0 ){
+    found.face = surfaces.index( inter.Face( iHit ));
+    found.u    = inter.UParameter( iHit );
+    found.v    = inter.VParameter( iHit );
+  }
+  return result;
+}
+
+// ================================================== _localIntersect
+// Newton on S(u,v) = Pt + t*dir. The point must stay on the face, else the
+// intersection is likely on another associated face.
+bool SMESH_HexaBlocks::_localIntersect( const gp_Pnt& Pt, const gp_Dir& dir,
+                                        const QuadSurfaces& surfaces,
+                                        SurfacePoint& uv,
+                                        gp_Pnt& result ) const
+{
+  const BRepAdaptor_Surface& surface = *surfaces.surfaces[ uv.face ];
+  const TopoDS_Face&         face    = surfaces.faces[ uv.face ];
+  double tol = BRep_Tool::Tolerance( face );
+
+  gp_Vec d( dir );
+  gp_Vec Su, Sv;
+  surface.D1( uv.u, uv.v, result, Su, Sv );
+  double t = gp_Vec( Pt, result ) * d;
+
+  bool converged = false;
+  for ( int iter = 0; iter < 10; ++iter ){
+    gp_Vec F( Pt.Translated( d*t ), result ); // S(u,v) - (Pt + t*dir)
+    if ( F.Magnitude() < tol ){
+      converged = true;
+      break;
     }
+    // [Su Sv -d] (du dv dt) = -F
+    gp_Vec c   = d * -1.;
+    gp_Vec r   = F * -1.;
+    double det = Su * ( Sv ^ c );
+    if ( fabs( det ) < gp::Resolution() )
+      return false;
+    uv.u += ( r  * ( Sv ^ c )) / det;
+    uv.v += ( Su * ( r  ^ c )) / det;
+    t    += ( Su * ( Sv ^ r )) / det;
+    surface.D1( uv.u, uv.v, result, Su, Sv );
   }
+  if ( !converged )
+    return false;
 
+  BRepClass_FaceClassifier classifier( face, gp_Pnt2d( uv.u, uv.v ), tol );
+  return classifier.State() != TopAbs_OUT;
+}
+
+// =================================================== _scoreQuadWays
+// The projections of the opposite vertices on the plane ( A, AB^AC ) of the
+// quad are along its normal: only the signs of their distances to the
+// plane matter, and they must be the same for the 4 vertices.
+void SMESH_HexaBlocks::_scoreQuadWays( const std::vector<HEXA_NS::Quad*>& quads,
+                                       std::vector<double>&               scores,
+                                       std::vector<char>&                 forward )
+{
+  int nbQuads = quads.size();
+  scores.assign( nbQuads, 0. );
+  forward.assign( nbQuads, 0 );
+
+  // gather A, B, C, D and their opposite vertices on the hexa,
   // working on final value ( point on CAO ), not on model
-  SMDS_MeshNode *nA = _node[qA], *nAA = _node[qAA];
-  SMDS_MeshNode *nB = _node[qB], *nBB = _node[qBB];
-  SMDS_MeshNode *nC = _node[qC], *nCC = _node[qCC];
-  SMDS_MeshNode *nD = _node[qD], *nDD = _node[qDD];
-
-  gp_Pnt pA( nA->X(), nA->Y(), nA->Z() );
-  gp_Pnt pB( nB->X(), nB->Y(), nB->Z() );
-  gp_Pnt pC( nC->X(), nC->Y(), nC->Z() );
-  gp_Pnt pD( nD->X(), nD->Y(), nD->Z() );
-
-  gp_Pnt pAA( nAA->X(), nAA->Y(), nAA->Z() );
-  gp_Pnt pBB( nBB->X(), nBB->Y(), nBB->Z() );
-  gp_Pnt pCC( nCC->X(), nCC->Y(), nCC->Z() );
-  gp_Pnt pDD( nDD->X(), nDD->Y(), nDD->Z() );
-
-  gp_Vec AB( pA, pB );
-  gp_Vec AC( pA, pC );
-  gp_Vec normP = AB^AC;
-  gp_Dir dirP( normP );
-
-  // building plane for point projection
-  gp_Pln plnP( gp_Pnt(nA->X(), nA->Y(), nA->Z()), dirP);
-  TopoDS_Shape sPlnP = BRepBuilderAPI_MakeFace(plnP).Face();
-
-  // PAAA is the result of PAA projection
-  gp_Pnt pAAA = _intersect( pAA, AB, AC, sPlnP );
-  gp_Pnt pBBB = _intersect( pBB, AB, AC, sPlnP );
-  gp_Pnt pCCC = _intersect( pCC, AB, AC, sPlnP );
-  gp_Pnt pDDD = _intersect( pDD, AB, AC, sPlnP );
-
-  gp_Dir AA( gp_Vec(pAA, pAAA) );
-  gp_Dir BB( gp_Vec(pBB, pBBB) );
-  gp_Dir CC( gp_Vec(pCC, pCCC) );
-  gp_Dir DD( gp_Vec(pDD, pDDD) );
-
-  // eventually, we are able to know if the input quad is a good client!
-  // exit the fonction otherwise
-  if ( AA.IsOpposite(BB, HEXA_QUAD_WAY) ) return;
-  if ( BB.IsOpposite(CC, HEXA_QUAD_WAY) ) return;
-  if ( CC.IsOpposite(DD, HEXA_QUAD_WAY) ) return;
-
-  // ok, give the input quad the good orientation by
-  // setting 2 vertex
-  if ( !dirP.IsOpposite(AA, HEXA_QUAD_WAY) ) { //OK
-      v0 = qA; v1 = qB;
-  } else {
-      v0 = qB; v1 = qA;
+  std::vector<double> xyz( 24*nbQuads, 0. );
+  std::vector<char>   valid( nbQuads, 0 );
+  for ( int k = 0; k < nbQuads; ++k ){
+    HEXA_NS::Quad* q = quads[k];
+    if ( q->getNbrParents() != 1 ) continue; // q must be a skin quad
+
+    HEXA_NS::Vertex* qV[8] = { q->getVertex(0), q->getVertex(1),
+                               q->getVertex(2), q->getVertex(3),
+                               NULL, NULL, NULL, NULL };
+    // searching for vertex on opposed quad
+    HEXA_NS::Hexa* h = q->getParent(0);
+    for( int i=0; i < h->countEdge(); ++i  ){
+      HEXA_NS::Edge* e = h->getEdge(i);
+      HEXA_NS::Vertex* e0 = e->getVertex(0);
+      HEXA_NS::Vertex* e1 = e->getVertex(1);
+      bool on0 = false, on1 = false;
+      for ( int iV = 0; iV < 4; ++iV ){
+        on0 = on0 || e0 == qV[iV];
+        on1 = on1 || e1 == qV[iV];
+      }
+      for ( int iV = 0; iV < 4; ++iV ){
+        if      ( e0 == qV[iV] && NOT on1 ) qV[4+iV] = e1;
+        else if ( e1 == qV[iV] && NOT on0 ) qV[4+iV] = e0;
+      }
+    }
+    valid[k] = 1;
+    for ( int iV = 0; iV < 8 && valid[k]; ++iV ){
+      std::map<HEXA_NS::Vertex*, SMDS_MeshNode*>::const_iterator n = _node.find( qV[iV] );
+      if ( qV[iV] == NULL || n == _node.end() || n->second == NULL ){
+        valid[k] = 0;
+        break;
+      }
+      xyz[ 24*k + 3*iV     ] = n->second->X();
+      xyz[ 24*k + 3*iV + 1 ] = n->second->Y();
+      xyz[ 24*k + 3*iV + 2 ] = n->second->Z();
+    }
   }
 
-  MESSAGE("_searchInitialQuadWay() : end");
+  // signed distances of the opposite vertices to the plane of the quad
+  for ( int k = 0; k < nbQuads; ++k ){
+    const double* p = &xyz[ 24*k ];
+    double ab[3] = { p[3]-p[0], p[4]-p[1], p[5]-p[2] };
+    double ac[3] = { p[6]-p[0], p[7]-p[1], p[8]-p[2] };
+    double n[3]  = { ab[1]*ac[2] - ab[2]*ac[1],
+                     ab[2]*ac[0] - ab[0]*ac[2],
+                     ab[0]*ac[1] - ab[1]*ac[0] };
+    double nn = sqrt( n[0]*n[0] + n[1]*n[1] + n[2]*n[2] );
+    if ( NOT valid[k] || nn <= gp::Resolution() )
+      continue;
+
+    double dMin = Precision::Infinite(), dSign = 0.;
+    bool   sameSide = true;
+    for ( int iV = 0; iV < 4; ++iV ){
+      const double* pp = p + 12 + 3*iV;
+      double d = ( (pp[0]-p[0])*n[0] + (pp[1]-p[1])*n[1] + (pp[2]-p[2])*n[2] ) / nn;
+      sameSide = sameSide && d*dSign >= 0.;
+      if ( iV == 0 ) dSign = d;
+      dMin = std::min( dMin, fabs( d ));
+    }
+    if ( sameSide && dMin > 0. ){
+      scores[k]  = dMin / sqrt( nn );
+      forward[k] = dSign < 0.; // the normal of A,B,C goes outside the hexa
+    }
+  }
 }
 
 SMESH_Group* SMESH_HexaBlocks::_createGroup(HEXA_NS::Group& grHex)
@@ -1689,10 +2952,10 @@ void SMESH_HexaBlocks::_fillGroup(HEXA_NS::Group* grHex )
         {
             HEXA_NS::Quad* q = reinterpret_cast<HEXA_NS::Quad*>(grHexElt);
             if ( _quadNodes.count(q)>0 ){
-              ArrayOfSMESHNodes nodesOnQuad = _quadNodes[q];
-              for ( ArrayOfSMESHNodes::iterator nodes = nodesOnQuad.begin(); nodes != nodesOnQuad.end(); ++nodes){
-                for ( SMESHNodes::iterator aNode = nodes->begin(); aNode != nodes->end(); ++aNode){
-                  aGrEltIDs.push_back(*aNode);
+              const QuadGrid& nodesOnQuad = _quadNodes[q];
+              for ( int i = 0; i < nodesOnQuad.iSize(); ++i ){
+                for ( int j = 0; j < nodesOnQuad.jSize(); ++j ){
+                  aGrEltIDs.push_back( nodesOnQuad.node(i, j) );
                 }
               }
             } else {
@@ -37,9 +37,22 @@
 #endif
 
 #include <gp_Pnt.hxx>
+#include <gp_Pnt2d.hxx>
 #include <gp_Vec.hxx>
+#include <gp_XYZ.hxx>
 #include <TopoDS_Face.hxx>
 #include <BRepAdaptor_Curve.hxx>
+#include <BRepAdaptor_Surface.hxx>
+#include <list>
+#include <map>
+#include <vector>
+
+class IntCurvesFace_ShapeIntersector;
+class SMESH_MesherHelper;
+
+// Number of blocks ( hexas ) whose inner points are computed in parallel at
+// once, then added to the mesh
+#define HEXA_POINTS_BATCH 256
 
 //=====================================================================
 // SMESH_HexaBlocks : class definition
@@ -54,7 +67,28 @@ public:
   typedef std::vector<SMDS_MeshFace*>    SMESHFaces;
   typedef std::vector<SMDS_MeshEdge*>    SMESHEdges;
 
-  typedef std::vector< SMESHNodes >      ArrayOfSMESHNodes;
+  // Nodes of a quad in one row-major block [i*jSize+j], each one beside its
+  // point: the interpolated one while the quad is computed
+  class QuadGrid{
+  public:
+    QuadGrid(): _iSize(0), _jSize(0) {}
+    void resize( int iSize, int jSize );
+    void clear()                 { resize( 0, 0 ); }
+    void swap( QuadGrid& other );
+    int  iSize() const           { return _iSize; }
+    int  jSize() const           { return _jSize; }
+    SMDS_MeshNode*& node( int i, int j )        { return _cells[ i*_jSize + j ].node; }
+    SMDS_MeshNode*  node( int i, int j ) const  { return _cells[ i*_jSize + j ].node; }
+    gp_Pnt&         point( int i, int j )       { return _cells[ i*_jSize + j ].point; }
+    const gp_Pnt&   point( int i, int j ) const { return _cells[ i*_jSize + j ].point; }
+  private:
+    struct Cell{
+      SMDS_MeshNode* node;
+      gp_Pnt         point;
+    };
+    int               _iSize, _jSize;
+    std::vector<Cell> _cells;
+  };
 
   struct Coord{
     double x;
@@ -84,11 +118,28 @@ public:
   bool computeEdgeByIsoWire( HEXA_NS::Edge& edge, HEXA_NS::Law& law);
   bool computeEdgeBySegment( HEXA_NS::Edge& edge, HEXA_NS::Law& law);
 
+  // All the edges of the document, propagation by propagation
+  bool computeEdges( HEXA_NS::Document* doc );
+
+  // Points on associated edges and in quads are computed on all the cores
+  // before the nodes are added to the mesh ( same mesh as in serial mode )
+  void setParallel( bool parallel ) { _parallel = parallel; }
+  bool isParallel() const { return _parallel; }
+
+  // Quad nodes are projected on the faces searched within this number of
+  // cell sizes from the interpolated point, then in a growing window;
+  // 0 to search along the whole line
+  void   setRayWindow( double nbCells ) { _rayWindow = nbCells; }
+  double getRayWindow() const { return _rayWindow; }
+
   // --------------------------------------------------------------
   //  Quad computing
   // --------------------------------------------------------------
   std::map<HEXA_NS::Quad*, bool>  computeQuadWays( HEXA_NS::Document* doc );
   bool computeQuad( HEXA_NS::Quad& quad, bool way );
+  // All the used quads of the document. In parallel mode, the inner nodes of
+  // the quads are computed on all the cores before being added to the mesh
+  bool computeQuads( HEXA_NS::Document* doc );
   // Association solving
   bool computeQuadByAssoc( HEXA_NS::Quad& quad, bool way );
   // Automatic solving
@@ -99,6 +150,8 @@ public:
   //  Hexa computing
   // --------------------------------------------------------------
   bool computeHexa( HEXA_NS::Document* doc );
+  // From the grids of the quads of each hexa, false if one is missing
+  bool computeHexaByQuads( HEXA_NS::Document* doc );
 
   // --------------------------------------------------------------
   //  Document computing: Vertex, Edge, Quad and Hexa computing
@@ -106,6 +159,17 @@ public:
   bool computeDoc( HEXA_NS::Document* doc );
 
 
+  // --------------------------------------------------------------
+  //  Mesh size, known from the document topology and the laws only
+  // --------------------------------------------------------------
+  struct Counts{
+    smIdType nbNodes;
+    smIdType nbEdges;
+    smIdType nbQuads;
+    smIdType nbHexas;
+  };
+  static Counts countDoc( HEXA_NS::Document* doc, int dim = 3 );
+
   // --------------------------------------------------------------
   //  Build groups
   // --------------------------------------------------------------
@@ -115,50 +179,307 @@ public:
 private:
   //    ********     METHOD FOR MESH COMPUTATION    ********
   //  EDGE
-  double _Xx( double i, HEXA_NS::Law law, double nbNodes );
+  // Arc length table of a CAD curve, on a regular sampling of its parameter
+  // range. Shared by all the associations to this curve
+  struct CurveLengths{
+    std::vector<double> params;
+    std::vector<double> abscissas; // from the range start
+    double              speed;     // ds/du of lines and circles, 0 otherwise
+    bool                byTable;   // parameters are found from the table only
+
+    double length() const { return abscissas.back(); }
+    // parameter at an abscissa from the range start, by inversion of the
+    // table and Newton iterations
+    double parameter( const BRepAdaptor_Curve& curve, double abscissa ) const;
+    // nearest sample of an abscissa, -1 if out of range
+    int    sample( double abscissa ) const;
+    // abscissa of a parameter, -1 if out of range
+    double abscissa( const BRepAdaptor_Curve& curve, double u ) const;
+  };
+
+  // Lengths of the curves by CAD edge ( TShape and scale of its location ) and
+  // parameter range. Filled by the serial steps of a compute, read only
+  // otherwise. The curve adaptors are those of the associations, owned by
+  // the document, so only the tables are kept.
+  class CurveCache{
+  public:
+    CurveCache(): _nbHits(0), _nbMisses(0) {}
+    const CurveLengths& get( const BRepAdaptor_Curve& curve );
+    int nbHits()   const { return _nbHits; }
+    int nbMisses() const { return _nbMisses; }
+  private:
+    struct Key{
+      const void* tshape;
+      double      scale;   // of the edge location
+      double      first, last;
+      bool operator<( const Key& k ) const;
+    };
+    std::map< Key, CurveLengths > _lengths;
+    int _nbHits, _nbMisses;
+  };
+
+  // Part of the composite curve an associated edge is discretized on
+  struct CurveSegment{
+    BRepAdaptor_Curve*  curve;
+    bool                way;     // true if the abscissa grows with the parameter
+    double              uStart;  // parameter of the association start
+    double              length;  // length of the association
+    double              start;   // abscissa of the segment start on MyCurve
+    const CurveLengths* lengths; // of curve
+    double              sStart;  // abscissa of uStart on curve, -1 if unknown
+
+    static bool startsAfter( double u, const CurveSegment& s ) { return u < s.start; }
+  };
+  // Segments of the composite curve, in the way of discretization
+  typedef std::vector<CurveSegment> MyCurve;
+
+  // Last point computed on a MyCurve, origin of the next integration
+  struct CurveCursor{
+    int    segment;
+    double abscissa;  // from the association start
+    double param;
+    CurveCursor(): segment(-1), abscissa(0.), param(0.) {}
+  };
 
-  double _edgeLength(const TopoDS_Edge & E);
+  // Discretization of an associated edge, computed apart from the mesh
+  struct EdgeDiscretization{
+    HEXA_NS::Edge*                         edge;
+    HEXA_NS::Law*                          law;
+    bool                                   byAssoc; // else computeEdge() at commit
+    bool                                   done;    // points computed
+    SMDS_MeshNode*                         firstNode;
+    SMDS_MeshNode*                         lastNode;
+    MyCurve                                myCurve;
+    double                                 myCurve_tot_len;
+    const std::vector<double>*             xx;      // law parameters of the nodes
+    std::vector<gp_Pnt>                    points;  // nodes between first and last
+  };
+  struct EdgePointsFunctor; // computes points of EdgeDiscretization's in parallel
+
+  bool _prepareEdgeByAssoc( HEXA_NS::Edge& edge, HEXA_NS::Law& law,
+                            EdgeDiscretization& discr );
+  void _computeEdgePoints( EdgeDiscretization& discr,
+                           bool privateCurves = false ) const; // thread safe if privateCurves
+  bool _commitEdgeByAssoc( EdgeDiscretization& discr );
+
+  // Normalized parameters of the inner nodes of a discretization law, shared
+  // by all the edges using a law of the same kind, coefficient and nbNodes
+  struct LawKey{
+    HEXA_NS::KindLaw kind;
+    double           coeff;
+    int              nbNodes;
+    bool operator<( const LawKey& k ) const;
+  };
+  const std::vector<double>& _Xx( HEXA_NS::Law& law );
 
   void _buildMyCurve(
       const gp_Pnt&                             myCurve_start,  //IN
       const gp_Pnt&				myCurve_end,    //IN
-      std::list< BRepAdaptor_Curve* >& 	        myCurve,        //INOUT
+      MyCurve&                                  myCurve,        //INOUT
       double& 				        myCurve_length, //INOUT
-      std::map< BRepAdaptor_Curve*, double>& 	myCurve_lengths,//INOUT
-      std::map< BRepAdaptor_Curve*, bool>& 	myCurve_ways,   //INOUT
-      std::map< BRepAdaptor_Curve*, double>&    myCurve_starts,   //INOUT
       HEXA_NS::Edge&                            edge);  // For diagnostic
 
   gp_Pnt _getPtOnMyCurve(
       const double&                           myCurve_u,      //IN
-      std::map< BRepAdaptor_Curve*, bool>&    myCurve_ways,   //IN
-      std::map< BRepAdaptor_Curve*, double>&  myCurve_lengths,//IN
-      std::map< BRepAdaptor_Curve*, double>&  myCurve_starts, //IN
-      std::list< BRepAdaptor_Curve* >&        myCurve,        //INOUT
-      double&                                 myCurve_start); //INOUT
+      const MyCurve&                          myCurve,        //IN
+      CurveCursor&                            cursor) const;  //INOUT
 
   // QUAD
-  void _nodeInterpolationUV( double u, double v,
-    SMDS_MeshNode* Pg, SMDS_MeshNode* Pd, SMDS_MeshNode* Ph, SMDS_MeshNode* Pb,
-    SMDS_MeshNode* S0, SMDS_MeshNode* S1, SMDS_MeshNode* S2, SMDS_MeshNode* S3,
-    double& xOut, double& yOut, double& zOut );
+  // Transfinite ( Coons ) interpolation of one coordinate on the inner
+  // nodes of a quad, from its values on the boundary: b[i], h[i] at
+  // j = 0, jSize-1 and g[j], d[j] at i = 0, iSize-1
+  static void _coonsPatch( int iSize, int jSize,
+                           const double* xx, const double* yy,  //IN: parameters of the nodes
+                           const double* b,  const double* h,   //IN: [iSize]
+                           const double* g,  const double* d,   //IN: [jSize]
+                           double* out );                       //OUT: [i*jSize+j]
+
+  // Counts of the projections of quad nodes
+  struct ProjectionStats{
+    int nbLocal;     // by _localIntersect
+    int nbGlobal;    // by the intersector
+    int nbNotFound;  // by none
+    int nbRetries;   // expansions of the search window of the intersector
+    ProjectionStats(): nbLocal(0), nbGlobal(0), nbNotFound(0), nbRetries(0) {}
+    void add( const ProjectionStats& s )
+    { nbLocal += s.nbLocal; nbGlobal += s.nbGlobal; nbNotFound += s.nbNotFound;
+      nbRetries += s.nbRetries; }
+  };
+
+  // Quad being computed: the inner points are computed apart from the
+  // mesh, which is modified at commit only
+  struct QuadDiscretization{
+    HEXA_NS::Quad*      quad;
+    bool                way;
+    bool                byAssoc;     // else linear approximation
+    bool                done;        // points computed
+    QuadGrid            nodesOnQuad; // boundary nodes, inner ones at commit
+    std::vector<double> xx, yy;
+    std::vector<gp_Pnt> points;      // inner points [i*jSize+j]
+    ProjectionStats     stats;
+    TopoDS_Face           face;      // found by computeQuadByFindingGeom
+    std::vector<gp_Pnt2d> uvOnQuad;  // boundary parameters on face [i*jSize+j]
+    // associated faces, resolved at preparation so that the computation
+    // does not read the document
+    std::vector<TopoDS_Shape> assoShapes; // in the order of the associations
+    TopoDS_Shape              assoShape;  // all of them, a compound if several
+    std::vector<HEXA_NS::FaceShape*> assoKey; // FaceShapesKey
+  };
+  struct QuadPointsFunctor; // computes points of QuadDiscretization's in parallel
+
+  class IntersectorCache;
+  bool _prepareQuad( HEXA_NS::Quad& quad, bool way, bool byAssoc,
+                     QuadDiscretization& discr );
+  bool _prepareQuadByFindingGeom( HEXA_NS::Quad& quad, bool way,
+                                  QuadDiscretization& discr );
+  void _computeQuadPoints( QuadDiscretization& discr,
+                           IntersectorCache& intersectors ) const; // thread safe
+  bool _commitQuad( QuadDiscretization& discr );
+
+  // Parameters on a face of the boundary nodes of a quad, continuous
+  // across the seams
+  bool _projectQuadBoundary( const TopoDS_Face&        face,         //IN
+                             const QuadGrid&           nodesOnQuad,  //IN
+                             std::vector<gp_Pnt2d>&    uvOnQuad ) const; //OUT [i*jSize+j]
+
+  // Bounding box tree over the faces of the shape to mesh, to find the
+  // faces near a point. Built once, read only afterwards.
+  class FaceTree{
+  public:
+    FaceTree(): _built(false) {}
+    void build( const TopoDS_Shape& shape );
+    bool isBuilt() const                     { return _built; }
+    const TopoDS_Face& face( int i ) const   { return _faces[i]; }
+    // faces whose box is at less than tol from p, sorted
+    void findNear( const gp_Pnt& p, double tol, std::vector<int>& found ) const;
+  private:
+    struct Box{
+      double min[3], max[3];
+      bool isOut( const gp_Pnt& p, double tol ) const;
+    };
+    struct Node{
+      Box box;
+      int first, last; // range in _order
+      int left, right; // children, -1 for a leaf
+    };
+    int _build( int first, int last );
+
+    bool                     _built;
+    std::vector<TopoDS_Face> _faces;
+    std::vector<Box>         _boxes;
+    std::vector<int>         _order; // faces in the order of the leaves
+    std::vector<Node>        _nodes; // root first
+  };
 
   // TopoDS_Shape _getShapeOrCompound( const std::vector<HEXA_NS::Shape*>& shapesIn );
-  TopoDS_Shape getFaceShapes (Hex::Quad& quad);
+  TopoDS_Shape getFaceShapes (Hex::Quad& quad) const;
+
+  // Faces associated to a quad, sorted: quads on the same CAD patch have
+  // the same key
+  typedef std::vector<HEXA_NS::FaceShape*> FaceShapesKey;
+  static FaceShapesKey _faceShapesKey( HEXA_NS::Quad& quad );
+
+  // Compounds of the faces associated to the quads, shared by the quads of
+  // a same key. Filled by the serial steps of a compute, read only otherwise.
+  class FaceCompoundCache{
+  public:
+    FaceCompoundCache(): _nbHits(0), _nbMisses(0) {}
+    const TopoDS_Shape& add( HEXA_NS::Quad& quad );
+    const TopoDS_Shape* find( HEXA_NS::Quad& quad ) const; // NULL if not added
+    int size()     const { return _compounds.size(); }
+    int nbHits()   const { return _nbHits; }
+    int nbMisses() const { return _nbMisses; }
+  private:
+    std::map< FaceShapesKey, TopoDS_Shape > _compounds;
+    int _nbHits, _nbMisses;
+  };
 
   gp_Pnt _intersect( const gp_Pnt& Pt,
                      const gp_Vec& u, const gp_Vec& v,
-                     const TopoDS_Shape& s,
-                     Standard_Real tol = 0.0001 );
+                     IntCurvesFace_ShapeIntersector& inter,
+                     int* iHit = NULL,              // OUT: index of the point in inter, 0 if none
+                     int* nbRetries = NULL ) const; // INOUT: expansions of the search window
+
+  // Point on one of the faces associated to a quad
+  struct SurfacePoint{
+    int    face;  // index in QuadSurfaces, -1 if unknown
+    double u, v;
+    SurfacePoint(): face(-1), u(0.), v(0.) {}
+  };
+  // Faces associated to a quad, for the local projections
+  struct QuadSurfaces{
+    std::vector<TopoDS_Face>          faces;
+    std::vector<BRepAdaptor_Surface*> surfaces;
+    ~QuadSurfaces();
+    void load( const std::vector<TopoDS_Shape>& shapes );
+    int index( const TopoDS_Face& face ) const;
+  };
+
+  // Projection along the normal of the quad: by Newton iterations on the
+  // face of a neighbour node, from its parameters, or by the intersector
+  // if they do not converge on the face
+  gp_Pnt _projectOnQuad( const gp_Pnt& Pt,
+                         const gp_Vec& u, const gp_Vec& v,
+                         const QuadSurfaces& surfaces,
+                         IntCurvesFace_ShapeIntersector& inter,
+                         const SurfacePoint& seed,    //IN
+                         SurfacePoint& found,         //OUT
+                         ProjectionStats& stats ) const;
+  bool _localIntersect( const gp_Pnt& Pt, const gp_Dir& dir,
+                        const QuadSurfaces& surfaces,
+                        SurfacePoint& uv,             //INOUT
+                        gp_Pnt& result ) const;       //OUT
+
+  // Intersectors loaded with the faces associated to a quad, kept for the
+  // next quads associated to the same faces. The least recently used one is
+  // removed when the cache is full.
+  class IntersectorCache{
+  public:
+    IntersectorCache(): _nbHits(0), _nbMisses(0) {}
+    ~IntersectorCache();
+    IntCurvesFace_ShapeIntersector& get( const FaceShapesKey& key,
+                                         const TopoDS_Shape&  faces,
+                                         Standard_Real tol = 0.0001 );
+    int nbHits()   const { return _nbHits; }
+    int nbMisses() const { return _nbMisses; }
+    // count the uses of another cache, e.g. of a worker thread
+    void addStats( const IntersectorCache& other )
+    { _nbHits += other._nbHits; _nbMisses += other._nbMisses; }
+  private:
+    typedef FaceShapesKey Key;
+    typedef std::list< std::pair< Key, IntCurvesFace_ShapeIntersector* > > Entries;
+    Entries                                _entries; // most recent first
+    std::map< Key, Entries::iterator >     _index;
+    int _nbHits, _nbMisses;
+  };
+
+  // Nodes of a hexa [(x*ySize + y)*zSize + z]: x and y on its first quad,
+  // z from it to the opposite quad
+  struct HexaGrid{
+    HEXA_NS::Hexa*                    hexa;
+    int                               xSize, ySize, zSize;
+    std::vector<const SMDS_MeshNode*> nodes; // inner ones NULL until commit
+    std::vector<gp_XYZ>               points; // inner ones, in x, y, z order
+    bool                              done;   // points computed
+    HexaGrid(): hexa(NULL), xSize(0), ySize(0), zSize(0), done(false) {}
+    const SMDS_MeshNode*& node( int x, int y, int z ) { return nodes[ (x*ySize + y)*zSize + z ]; }
+  };
+  struct HexaPointsFunctor; // computes points of HexaGrid's in parallel
+  bool _prepareHexa( HEXA_NS::Hexa& hexa, HexaGrid& grid );
+  void _computeHexaPoints( HexaGrid& grid ) const; // thread safe
+  void _commitHexa( HexaGrid& grid, SMESH_MesherHelper& helper );
 
   bool _computeQuadInit(
     HEXA_NS::Quad& quad,
-    ArrayOfSMESHNodes& nodesOnQuad,
+    QuadGrid& nodesOnQuad,
     std::vector<double>& xx, std::vector<double>& yy);
 
-  void _searchInitialQuadWay( HEXA_NS::Quad* quad, //IN
-                              HEXA_NS::Vertex*& v0,      //INOUT
-                              HEXA_NS::Vertex*& v1 );    //INOUT
+  // Orientation of skin quads from the side of their hexa. The score is the
+  // smallest distance of the opposite vertices to the plane of the quad,
+  // relative to the quad size; 0 if the quad can't be an initial quad
+  void _scoreQuadWays( const std::vector<HEXA_NS::Quad*>& quads,     //IN
+                       std::vector<double>&               scores,    //OUT
+                       std::vector<char>&                 forward ); //OUT: v0,v1 = A,B
 
 
   //    ********     DATA FOR MESH COMPUTATION    ********
@@ -170,11 +491,19 @@ private:
   std::map<HEXA_NS::Edge*, SMESHNodes>  _nodesOnEdge; //_edgeNodes;
 //   std::map<HEXA_NS::Edge*, Xx>                _edgeXx;
   std::map<SMDS_MeshNode*, double>  _nodeXx; //_edgeNodes;
-  std::map<HEXA_NS::Quad*, ArrayOfSMESHNodes> _quadNodes;
+  std::map<HEXA_NS::Quad*, QuadGrid> _quadNodes;
 
   bool _computeVertexOK;
   bool _computeEdgeOK;
   bool _computeQuadOK;
+  bool _parallel;
+  double _rayWindow;
+
+  CurveCache _curveCache;
+  IntersectorCache _intersectors;
+  FaceCompoundCache _faceCompounds;
+  FaceTree _faceTree;
+  std::map< LawKey, std::vector<double> > _lawTables;
 
   SMESHDS_Mesh* _theMeshDS;
   SMESH_Mesh*   _theMesh;
@@ -189,10 +518,8 @@ private:
   std::map<HEXA_NS::Edge*, SMESHEdges>   _edgesOnEdge;
 
 
-  // for DEBUG purpose only:
-  int _total;
-  int _found;
-  int _notFound;
+  // projections of the quad nodes by _projectOnQuad
+  ProjectionStats _projections;
 };
 
 